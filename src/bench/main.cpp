@@ -0,0 +1,520 @@
+#include "chamber.hpp"
+#include "kernels.hpp"
+#include "parallel.hpp"
+#include "physconstants.hpp"
+#include "raw.hpp"
+#include "screen.hpp"
+#include "superposition.hpp"
+#include "surface.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Micro benchmarks of the engine. Every case runs on one thread so the
+// numbers compare code paths, not the pool.
+//
+//   physbench            runs every case
+//   physbench <case>...  runs the named ones
+//
+// The exit status is 1 when a case found results that disagree beyond
+// its tolerance; "physbench methods" alone is the regression check of the
+// propagation methods, "physbench incremental" that of Chamber::update.
+
+using namespace phys;
+
+namespace {
+
+template <typename F>
+double
+seconds(F&& f, size_t repeats = 3) {
+  double best = 1e300;
+  for(size_t r = 0; r < repeats; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(stop - start).count());
+  }
+  return best;
+}
+
+void
+report(const std::string& name, double time, double items, const char* unit) {
+  std::cout << "  " << name << ": " << time * 1e9 / items << " ns/" << unit << '\n';
+}
+
+ContigSurface
+grid(size_t resolution, LengthVal z) {
+  ContigSurface surface(Position{1e-2_m, 1e-2_m, z});
+  surface.setResolution(resolution);
+  return surface;
+}
+
+//====================================================================================/
+//===================================< Unit erasure >=================================/
+//====================================================================================/
+
+// The original propagation loop: LightSource records, Unit<> arithmetic and
+// EWave::traveled for every pair.
+void
+propagateWrapped(const Field& src, Field& dst, const WavyEnvironment& env) {
+  const std::vector<LightSource> srcs = src.sources();
+  for(size_t i = 0; i < dst.size(); ++i) {
+    Position target = dst.position(i);
+    EWave sum;
+    for(const auto& [wave, pos] : srcs) {
+      sum += wave.traveled((pos - target).Len(), env);
+    }
+    dst.setWave(i, sum);
+  }
+}
+
+// The same loop on the raw streams of the field.
+void
+propagateRaw(const Field& src, Field& dst, const WavyEnvironment& env) {
+  const double lambda = raw::wavelength(env);
+  const double loss   = raw::loss(env);
+  for(size_t i = 0; i < dst.size(); ++i) {
+    double re = 0.;
+    double im = 0.;
+    for(size_t j = 0; j < src.size(); ++j) {
+      double x = src.xs()[j] - dst.xs()[i];
+      double y = src.ys()[j] - dst.ys()[i];
+      double z = src.zs()[j] - dst.zs()[i];
+      double l = std::sqrt(x * x + y * y + z * z);
+      double amp = loss / l;
+      double c = std::cos(l / lambda);
+      double s = std::sin(l / lambda);
+      double wre = src.re()[j] * amp;
+      double wim = src.im()[j] * amp;
+      re += wre * c - wim * s;
+      im += wre * s + wim * c;
+    }
+    dst.re()[i] = re;
+    dst.im()[i] = im;
+  }
+}
+
+double
+maxDifference(const Field& a, const Field& b) {
+  double err = 0.;
+  for(size_t i = 0; i < a.size(); ++i) {
+    err = std::max(err, std::abs(a.re()[i] - b.re()[i]) + std::abs(a.im()[i] - b.im()[i]));
+  }
+  return err;
+}
+
+bool
+benchUnits() {
+  std::cout << "units: one channel, libm sin/cos\n";
+  WavyEnvironment env{consts::red, 1.__};
+  ContigSurface src = grid(64, -1_m);
+  ContigSurface dst = grid(64, 0_m);
+  src.setEnvironment(env);
+  dst.setEnvironment(env);
+
+  Field wrapped = dst.getField();
+  Field plain   = dst.getField();
+  Field kernel  = dst.getField();
+  const double pairs = static_cast<double>(src.getField().size() * wrapped.size());
+
+  double tWrapped = seconds([&] {propagateWrapped(src.getField(), wrapped, env);});
+  double tPlain   = seconds([&] {propagateRaw(src.getField(), plain, env);});
+  double tKernel  = seconds([&] {
+    Surface::recalculate(src.getField(), kernel, {env}, {Kernel::Scalar, SinCos::Exact});
+  });
+  report("Unit<> loop        ", tWrapped, pairs, "pair");
+  report("double loop        ", tPlain, pairs, "pair");
+  report("kernels::scalar    ", tKernel, pairs, "pair");
+  std::cout << "  max difference " << std::max(maxDifference(wrapped, plain), maxDifference(wrapped, kernel)) << '\n';
+
+  std::cout << "units: bounds of a field\n";
+  const Field& field = src.getField();
+  const double points = static_cast<double>(field.size());
+  std::pair<Position, Position> rect;
+  raw::Box box;
+  double tMinMax = seconds([&] {
+    rect = {field.position(0), field.position(0)};
+    for(size_t i = 0; i < field.size(); ++i) {
+      rect.first  = std::min(rect.first,  field.position(i));
+      rect.second = std::max(rect.second, field.position(i));
+    }
+  }, 50);
+  double tBox = seconds([&] {box = raw::bounds(field);}, 50);
+  report("std::min/max on Position", tMinMax, points, "point");
+  report("raw::bounds             ", tBox, points, "point");
+  if(box.rect().first.X() != rect.first.X()) {
+    std::cout << "  bounds differ\n";
+    return false;
+  }
+  return true;
+}
+
+//====================================================================================/
+//====================================< Tiling >======================================/
+//====================================================================================/
+
+// Nominal source bytes per pair, not a measurement: without tiling every
+// destination streams the whole source set, and a block of them shares a
+// tile from beyond L2. What that saves shows in the time per pair, first
+// against the source count and then against tileBytes.
+bool 
+benchTiles() {
+  constexpr const double Block = 64.;
+  std::cout << "tiles: one channel, SIMD kernel, 256 destinations\n";
+  WavyEnvironment env{consts::red, 1.__};
+  ContigSurface dst = grid(16, 0_m);
+  dst.setEnvironment(env);
+  Field tiled   = dst.getField();
+  Field untiled = dst.getField();
+  const double bytes = static_cast<double>(5 * sizeof(double));
+
+  for(size_t resolution : {32, 100, 316, 1000}) {
+    ContigSurface src = grid(resolution, -1_m);
+    src.setEnvironment(env);
+    const Field& field = src.getField();
+    const double pairs = static_cast<double>(field.size() * tiled.size());
+
+    PropagationConfig config{Kernel::Simd};
+    double tTiled = seconds([&] {Surface::recalculate(field, tiled, {env}, config);});
+    config.tileBytes = 0;
+    double tUntiled = seconds([&] {Surface::recalculate(field, untiled, {env}, config);});
+
+    std::cout << "  " << field.size() << " sources, " << bytes * static_cast<double>(field.size()) / 1024. 
+              << " KiB\n";
+    std::cout << "    untiled: " << tUntiled * 1e9 / pairs << " ns/pair, nominal " << bytes << " B/pair\n";
+    std::cout << "    tiled  : " << tTiled * 1e9 / pairs << " ns/pair, nominal " << bytes / Block << " B/pair\n";
+    if(!raw::same(maxDifference(tiled, untiled), 0.)) {
+      std::cout << "  tiled sums differ\n";
+      return false;
+    }
+  }
+
+  ContigSurface src = grid(316, -1_m);
+  src.setEnvironment(env);
+  const Field& field = src.getField();
+  const double pairs = static_cast<double>(field.size() * tiled.size());
+  std::cout << "  " << field.size() << " sources by tileBytes\n";
+  for(size_t tileBytes : {size_t{0}, size_t{1} << 14, size_t{1} << 16, size_t{1} << 18, size_t{1} << 20, size_t{1} << 22}) {
+    PropagationConfig config{Kernel::Simd};
+    config.tileBytes = tileBytes;
+    double time = seconds([&] {Surface::recalculate(field, tiled, {env}, config);});
+    std::cout << "    " << tileBytes / 1024 << " KiB: " << time * 1e9 / pairs << " ns/pair\n";
+  }
+  return true;
+}
+
+//====================================================================================/
+//===================================< Methods >======================================/
+//====================================================================================/
+
+// Largest difference over every channel relative to the largest amplitude
+// of the reference.
+double
+relativeError(const Field& field, const Field& reference) {
+  double err = 0.;
+  double peak = 0.;
+  for(size_t ch = 0; ch < reference.channels(); ++ch) {
+    for(size_t i = 0; i < reference.size(); ++i) {
+      err  = std::max(err, std::hypot(field.re(ch)[i] - reference.re(ch)[i], field.im(ch)[i] - reference.im(ch)[i]));
+      peak = std::max(peak, std::hypot(reference.re(ch)[i], reference.im(ch)[i]));
+    }
+  }
+  return err / peak;
+}
+
+// Every method against Method::Direct on a hop between two grids of the
+// same pitch, where each of them applies, and on a longer one from a
+// random set of holes, where the grid methods fall back to the direct sum
+// and Tree takes far pairs.
+bool
+benchMethods() {
+  struct Expected {
+    const char* name;
+    Method method;
+    double tolerance;
+  };
+  // Fft and Lookup sample the exact kernel; the Fresnel methods are off by
+  // the dropped path terms and by taking 1/l as 1/z, Tree by treeTolerance.
+  static const std::vector<Expected> Methods = {
+    {"fft     ", Method::Fft,      1e-9},
+    {"lookup  ", Method::Lookup,   1e-9},
+    {"chirpz  ", Method::ChirpZ,   1e-2},
+    {"paraxial", Method::Paraxial, 1e-2},
+    {"tree    ", Method::Tree,     1e-3},
+  };
+
+  std::cout << "methods: two channels, error relative to the direct sum\n";
+  const std::vector<WavyEnvironment> envs{{consts::red, 1.__}, {consts::blue, 1.__}};
+  PointLights light;
+  light.addSource({EWave{EFieldVal{1.}}, Position{3e-3_m, 6e-3_m, -12_m}});
+  light.setEnvironments(envs);
+
+  ContigSurface grating = grid(32, -1_m);
+  grating.setEnvironments(envs);
+  grating.update(light.getField());
+
+  constexpr const size_t Holes = 2000;
+  std::mt19937 random(1);
+  std::uniform_real_distribution<double> place(0., 1e-2);
+  std::vector<double> xs(Holes);
+  std::vector<double> ys(Holes);
+  std::vector<double> zs(Holes, -10.);
+  for(size_t i = 0; i < Holes; ++i) {
+    xs[i] = place(random);
+    ys[i] = place(random);
+  }
+  PointsBarrier holes;
+  holes.addHoles(xs.data(), ys.data(), zs.data(), Holes);
+  holes.setEnvironments(envs);
+  holes.update(light.getField());
+
+  ContigSurface screen = grid(32, 0_m);
+  screen.setEnvironments(envs);
+
+  bool agree = true;
+  for(const auto& [from, source] : {std::pair{"grid ", &grating.getField()}, std::pair{"holes", &holes.getField()}}) {
+    Field reference = screen.getField();
+    Surface::recalculate(*source, reference, envs);
+    for(const Expected& expected : Methods) {
+      Field field = screen.getField();
+      PropagationConfig config;
+      config.method = expected.method;
+      Surface::recalculate(*source, field, envs, config);
+      const double error = relativeError(field, reference);
+      const bool fits = error <= expected.tolerance;
+      std::cout << "  " << from << " " << expected.name << ": " << error 
+                << (fits ? "" : ", above the tolerance") << '\n';
+      agree &= fits;
+    }
+  }
+  return agree;
+}
+
+//====================================================================================/
+//=================================< Incremental >====================================/
+//====================================================================================/
+
+// What a chamber of light, holes, grid and screen is built from. Every
+// edit changes it as it changes the live chamber, so a chamber loaded
+// from it afresh computes what the live one should have followed.
+struct Setup {
+  std::vector<Frequency> frequencies{consts::red, consts::blue};
+  std::vector<double> power{1., 1.};
+  std::vector<std::pair<double, double>> holes{};
+  double holesZ = -1.;
+  double gridZ = -.5;
+  double screenZ = 0.;
+};
+
+struct Rig {
+  Chamber chamber{};
+  PointLights* lights = nullptr;
+  PointsBarrier* holes = nullptr;
+  ContigSurface* grid = nullptr;
+  std::unique_ptr<Screen> screen{};
+};
+
+std::unique_ptr<Rig>
+build(const Setup& setup) {
+  auto rig = std::make_unique<Rig>();
+  Scene scene;
+  scene.frequencies = setup.frequencies;
+
+  auto lights = std::make_unique<PointLights>();
+  lights->addSource({EWave{EFieldVal{1.}}, Position{5e-3_m, 5e-3_m, -2_m}});
+  for(size_t ch = 0; ch < setup.power.size(); ++ch) {
+    lights->setPower(ch, EFieldVal{setup.power[ch]});
+  }
+  auto holes = std::make_unique<PointsBarrier>();
+  for(const auto& [x, y] : setup.holes) {
+    holes->addHole(Position{LengthVal{x}, LengthVal{y}, LengthVal{setup.holesZ}});
+  }
+  auto grid = std::make_unique<ContigSurface>(Position{1e-2_m, 1e-2_m, LengthVal{setup.gridZ}});
+  grid->setResolution(16);
+
+  rig->lights = lights.get();
+  rig->holes = holes.get();
+  rig->grid = grid.get();
+  scene.surfaces.push_back(std::move(lights));
+  scene.surfaces.push_back(std::move(holes));
+  scene.surfaces.push_back(std::move(grid));
+  rig->chamber.load(std::move(scene));
+
+  rig->screen = std::make_unique<Screen>(Position{1e-2_m, 1e-2_m, LengthVal{setup.screenZ}});
+  rig->screen->setResolution(32);
+  rig->chamber.addSurface(rig->screen.get());
+  return rig;
+}
+
+// Largest difference of the intensities relative to the largest one of
+// the reference.
+double
+relativeError(const Intensity& intensity, const Intensity& reference) {
+  double err = 0.;
+  double peak = 0.;
+  for(size_t i = 0; i < reference.values.size(); ++i) {
+    err  = std::max(err, static_cast<double>(std::abs(intensity.values[i] - reference.values[i])));
+    peak = std::max(peak, static_cast<double>(reference.values[i]));
+  }
+  return err / peak;
+}
+
+// Chamber::update after each edit against a chamber loaded afresh with
+// the edit in place: power edits and moved or added holes followed by
+// superposition, moves in z and reorders that keep the hops in front,
+// new frequencies, previews refined after they finished or were
+// cancelled, and a final update cancelled half way. Runs with the default
+// cache budget, with none and with one the grid does not fit; frames and
+// snapshots a reader holds must never be written again.
+bool
+benchIncremental() {
+  enum class Preview {None, Finished, Cancelled};
+  struct Edit {
+    const char* name;
+    std::function<void(Setup&, Rig&)> apply;
+    Preview preview = Preview::None;
+    // Of the preview, the update after it is exact.
+    SinCos tier = SinCos::Table;
+  };
+  static const std::vector<Edit> Edits = {
+    {"power         ", [](Setup& s, Rig& r) {s.power[1] = 3.; r.lights->setPower(1, EFieldVal{3.});}},
+    {"move a hole   ", [](Setup& s, Rig& r) {
+      s.holes[2] = {4e-3, 7e-3};
+      r.holes->setHolePos(2, Position{4e-3_m, 7e-3_m, LengthVal{s.holesZ}});
+    }},
+    {"add holes     ", [](Setup& s, Rig& r) {
+      for(auto hole : {std::pair{2e-3, 2e-3}, std::pair{8e-3, 3e-3}}) {
+        s.holes.push_back(hole);
+        r.holes->addHole(Position{LengthVal{hole.first}, LengthVal{hole.second}, LengthVal{s.holesZ}});
+      }
+    }},
+    {"drag screen   ", [](Setup& s, Rig& r) {s.screenZ = .3; r.screen->setZ(LengthVal{s.screenZ});}},
+    {"drag grid     ", [](Setup& s, Rig& r) {s.gridZ = -.3; r.grid->setZ(LengthVal{s.gridZ});}},
+    {"grid past holes", [](Setup& s, Rig& r) {s.gridZ = -1.5; r.grid->setZ(LengthVal{s.gridZ});}},
+    {"power, preview", [](Setup& s, Rig& r) {s.power[0] = .5; r.lights->setPower(0, EFieldVal{.5});},
+     Preview::Finished},
+    {"power, cancel ", [](Setup& s, Rig& r) {s.power[0] = 2.; r.lights->setPower(0, EFieldVal{2.});},
+     Preview::Cancelled},
+    {"hole, cancel  ", [](Setup& s, Rig& r) {
+      s.holes[5] = {6e-3, 2e-3};
+      r.holes->setHolePos(5, Position{6e-3_m, 2e-3_m, LengthVal{s.holesZ}});
+    }, Preview::Cancelled, SinCos::Exact},
+    {"frequencies   ", [](Setup& s, Rig& r) {
+      s.frequencies = {consts::red, consts::green};
+      r.chamber.setLights(s.frequencies);
+    }},
+    {"power again   ", [](Setup& s, Rig& r) {s.power = {1., 1.}; r.lights->setPower(EFieldVal{1.});}},
+  };
+
+  Setup initial;
+  std::mt19937 random(2);
+  std::uniform_real_distribution<double> place(1e-3, 9e-3);
+  for(size_t i = 0; i < 8; ++i) {
+    initial.holes.emplace_back(place(random), place(random));
+  }
+
+  // Room for the snapshots of the light and the holes, not for the grid.
+  std::unique_ptr<Rig> sized = build(initial);
+  sized->chamber.update();
+  const size_t small = 2 * (superposition::footprint(sized->lights->getField()) + 
+                            superposition::footprint(sized->holes->getField())) + 
+                       superposition::footprint(sized->grid->getField());
+
+  bool agree = true;
+  for(const auto& [budget, cacheBytes] : {std::pair{"default", size_t{256} << 20}, std::pair{"no", size_t{0}},
+                                          std::pair{"small", small}}) {
+    std::cout << "incremental: " << budget << " cache, error relative to a fresh chamber\n";
+    Setup setup = initial;
+    std::unique_ptr<Rig> live = build(setup);
+    live->chamber.setCacheBytes(cacheBytes);
+    live->chamber.update();
+
+    std::shared_ptr<const Intensity> heldFrame = live->screen->frame();
+    const Intensity frameCopy = *heldFrame;
+    std::shared_ptr<const Field> heldSnapshot = live->holes->snapshot();
+    const Field snapshotCopy = heldSnapshot != nullptr ? *heldSnapshot : Field{};
+
+    for(const Edit& edit : Edits) {
+      edit.apply(setup, *live);
+      if(edit.preview != Preview::None) {
+        const bool cancel = edit.preview == Preview::Cancelled;
+        live->chamber.setSinCos(edit.tier);
+        std::atomic<bool> stop{cancel};
+        parallel::Cancellation cancellation(stop);
+        if(live->chamber.update() == cancel) {
+          std::cout << "  " << edit.name << ": preview " << (cancel ? "not cancelled" : "cancelled") << '\n';
+          agree = false;
+        }
+        live->chamber.setSinCos(SinCos::Exact);
+      }
+      double tLive = seconds([&] {live->chamber.update();}, 1);
+
+      std::unique_ptr<Rig> fresh = build(setup);
+      double tFresh = seconds([&] {fresh->chamber.update();}, 1);
+
+      // The screen keeps float intensities, a rescaled one is rounded twice.
+      const double error = relativeError(live->screen->intensity(), fresh->screen->intensity());
+      const bool fits = error <= 1e-6;
+      std::cout << "  " << edit.name << ": " << error << ", " << tLive * 1e3 << " ms against " 
+                << tFresh * 1e3 << " ms fresh" << (fits ? "" : ", above the tolerance") << '\n';
+      agree &= fits;
+
+      // Only the screen publishes beyond the budget.
+      bool published = false;
+      if(cacheBytes == 0) {
+        published = live->lights->snapshot() != nullptr || live->holes->snapshot() != nullptr;
+      }
+      if(cacheBytes <= small) {
+        published |= live->grid->snapshot() != nullptr;
+      }
+      if(published) {
+        std::cout << "  " << edit.name << ": published beyond the budget\n";
+        agree = false;
+      }
+    }
+
+    if(!raw::same(relativeError(*heldFrame, frameCopy), 0.) || live->screen->frame() == heldFrame) {
+      std::cout << "  a held frame was written again\n";
+      agree = false;
+    }
+    if(heldSnapshot != nullptr && (!raw::same(maxDifference(*heldSnapshot, snapshotCopy), 0.) ||
+                                   live->holes->snapshot() == heldSnapshot)) {
+      std::cout << "  a held snapshot was written again\n";
+      agree = false;
+    }
+  }
+  return agree;
+}
+
+// A case returns false when its results disagree.
+const std::vector<std::pair<std::string, std::function<bool()>>> Cases = {
+  {"units", benchUnits},
+  {"tiles", benchTiles},
+  {"methods", benchMethods},
+  {"incremental", benchIncremental},
+};
+
+}  // namespace
+
+int
+main(int argc, char* argv[]) {
+  parallel::setThreadCount(1);
+
+  bool agree = true;
+  for(const auto& [name, run] : Cases) {
+    bool selected = argc == 1;
+    for(int i = 1; i < argc; ++i) {
+      selected |= name == argv[i];
+    }
+    if(selected) {
+      agree &= run();
+    }
+  }
+  return agree ? 0 : 1;
+}
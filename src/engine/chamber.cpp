@@ -1,4 +1,8 @@
 #include "chamber.hpp"
+#include "parallel.hpp"
+#include "superposition.hpp"
+#include "sweep.hpp"
+#include <algorithm>
 
 namespace phys {
 
@@ -8,16 +12,188 @@ void Chamber::addSurface(Surface* surface) {
 }
 
 void 
+Chamber::load(Scene scene) {
+  clear();
+  for(size_t i = 0; i < scene.surfaces.size(); ++i) {
+    addSurface(scene.surfaces[i].get());
+    if(i < scene.ns.size()) {
+      m_ns.back() = scene.ns[i];
+    }
+  }
+  m_owned = std::move(scene.surfaces);
+  m_frequencies = std::move(scene.frequencies);
+}
+
+std::vector<WavyEnvironment> 
+Chamber::environments(RefractiveIndex n) const {
+  std::vector<WavyEnvironment> envs;
+  envs.reserve(m_frequencies.size());
+  for(Frequency f : m_frequencies) {
+    envs.emplace_back(f, n);
+  }
+  return envs;
+}
+
+bool 
 Chamber::update() {
   if(m_surfaces.empty()) {
-    return;
+    return true;
   }
   
   std::sort(m_surfaces.begin(), m_surfaces.end(), [](const Surface* lhs, const Surface* rhs) -> bool {return lhs->getZ() < rhs->getZ();});
-  for(size_t i = 0; i < m_surfaces.size()-1; ++i) {
-    m_surfaces[i+1]->setEnvironment({m_frequency, m_ns[i]});
-    m_surfaces[i+1]->update(m_surfaces[i]->getSrcs());
+
+  size_t first = 0;
+  while(first < m_surfaces.size() && unchanged(first)) {
+    ++first;
+  }
+  if(first == 0) {
+    m_surfaces[0]->setEnvironments(environments(1.__));
+  }
+
+  // A field that follows its source point by point keeps its tier, the
+  // surface goes on with the config it was computed with.
+  std::vector<SinCos> sincos(m_surfaces.size(), m_config.sincos);
+  std::copy_n(m_computed.sincos.begin(), first, sincos.begin());
+
+  // Surfaces in front of done hold valid fields. A hop the cancellation
+  // caught is not one of them, whether or not it was cut short.
+  size_t done = m_surfaces.size();
+  for(size_t i = std::max<size_t>(first, 1); i < m_surfaces.size(); ++i) {
+    if(i <= first || !unchanged(i) || !followSource(i)) {
+      m_surfaces[i]->setEnvironments(environments(m_ns[i-1]));
+      m_surfaces[i]->setPropagation(m_config);
+      m_surfaces[i]->update(m_surfaces[i-1]->getField());
+    } else {
+      sincos[i] = m_computed.sincos[i];
+    }
+    if(parallel::cancelled()) {
+      done = i;
+      break;
+    }
+  }
+
+  // Taken after the loop, which moves the revisions it touches itself.
+  m_computed.surfaces.clear();
+  for(size_t i = 0; i < done; ++i) {
+    m_computed.surfaces.emplace_back(m_surfaces[i], m_surfaces[i]->revision());
+  }
+  m_computed.ns = m_ns;
+  m_computed.frequencies = m_frequencies;
+  m_computed.config = m_config;
+  sincos.resize(done);
+  m_computed.sincos = std::move(sincos);
+
+  // Readers see every finished hop. The snapshots of the fields that feed
+  // a hop are also what followSource() compares against next time, from
+  // the light on while they fit the budget. Those in front of the first
+  // change are still valid, but may have been over the budget before.
+  size_t bytes = 0;
+  for(size_t i = 0; i < done; ++i) {
+    Surface* surface = m_surfaces[i];
+    if(i + 1 < m_surfaces.size()) {
+      bytes += 2 * superposition::footprint(surface->getField());
+      if(bytes > m_cacheBytes) {
+        surface->unpublish();
+        continue;
+      }
+    }
+    if(i >= first || surface->snapshot() == nullptr) {
+      surface->publish();
+    }
+  }
+  m_computed.fields.resize(m_surfaces.size() - 1);
+  for(size_t i = 0; i + 1 < m_surfaces.size(); ++i) {
+    m_computed.fields[i] = i < done ? m_surfaces[i]->snapshot() : nullptr;
+  }
+  return done == m_surfaces.size();
+}
+
+std::pair<LengthVal, LengthVal> 
+Chamber::lastHop(size_t planes) const {
+  const LengthVal front = m_surfaces[m_surfaces.size() - 2]->getZ();
+  const LengthVal back = m_surfaces.back()->getZ();
+  return {front + (back - front) / static_cast<double>(planes), back};
+}
+
+std::vector<Field> 
+Chamber::sweep(size_t planes) const {
+  if(m_surfaces.size() < 2 || planes == 0) {
+    return {};
   }
+
+  auto [near, far] = lastHop(planes);
+  std::vector<LengthVal> zs(planes);
+  for(size_t k = 0; k < planes; ++k) {
+    // Counted back from far, so the last plane is the surface itself.
+    LengthVal step = far - near;
+    step *= static_cast<double>(planes - 1 - k);
+    step /= static_cast<double>(std::max<size_t>(planes - 1, 1));
+    zs[k] = far - step;
+  }
+
+  const Surface* front = m_surfaces[m_surfaces.size() - 2];
+  return sweep::planes(front->getField(), m_surfaces.back()->points(), zs,
+                       environments(m_ns[m_surfaces.size() - 2]), m_config);
+}
+
+Field 
+Chamber::profile(size_t nx, size_t nz) const {
+  if(m_surfaces.size() < 2 || nx == 0 || nz == 0) {
+    return {};
+  }
+
+  auto [near, far] = lastHop(nz);
+  auto [beg, end] = m_surfaces.back()->getRect();
+  const LengthVal y = (beg.Y() + end.Y()) / 2;
+  const Surface* front = m_surfaces[m_surfaces.size() - 2];
+  return sweep::slice(front->getField(), Position{beg.X(), y, near}, Position{end.X(), y, far}, nx, nz,
+                      environments(m_ns[m_surfaces.size() - 2]), m_config);
+}
+
+bool 
+Chamber::unchanged(size_t i) const {
+  PropagationConfig computed = m_computed.config;
+  computed.sincos = m_config.sincos;
+  if(m_frequencies != m_computed.frequencies || m_config != computed) {
+    return false;
+  }
+  if(i >= m_computed.surfaces.size() || m_computed.surfaces[i].first != m_surfaces[i] ||
+     m_computed.surfaces[i].second != m_surfaces[i]->revision()) {
+    return false;
+  }
+  // SinCos runs from the most exact tier to the roughest.
+  if(m_computed.sincos[i] > m_config.sincos) {
+    return false;
+  }
+  return i == 0 || m_ns[i-1] == m_computed.ns[i-1];
+}
+
+bool 
+Chamber::followSource(size_t i) {
+  if(i - 1 >= m_computed.fields.size() || m_computed.fields[i-1] == nullptr ||
+     m_computed.surfaces[i-1].first != m_surfaces[i-1]) {
+    return false;
+  }
+
+  superposition::Difference diff = superposition::compare(*m_computed.fields[i-1], 
+                                                          m_surfaces[i-1]->getField());
+  switch(diff.kind) {
+    case superposition::Difference::Kind::Same:
+      return true;
+    case superposition::Difference::Kind::Scaled:
+      m_surfaces[i]->rescale(diff.factors);
+      return true;
+    case superposition::Difference::Kind::Points:
+      return m_surfaces[i]->updateDelta(diff.change);
+    case superposition::Difference::Kind::Other:
+    default:
+      return false;
+  }
+}
+
+void 
+Chamber::setThreadCount(size_t threads) {
+  parallel::setThreadCount(threads);
 }
 
 Chamber::~Chamber() {
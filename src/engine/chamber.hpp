@@ -1,15 +1,19 @@
 #ifndef CHAMBER_HPP
 #define CHAMBER_HPP
 
+#include "scene.hpp"
 #include "surface.hpp"
 #include "physconstants.hpp"
+#include <memory>
 
 namespace phys {
 
 class Chamber {
-  std::vector<Surface*> m_surfaces;
-  std::vector<RefractiveIndex> m_ns;
-  Frequency m_frequency;
+  std::vector<Surface*> m_surfaces{};
+  std::vector<std::unique_ptr<Surface>> m_owned{};
+  std::vector<RefractiveIndex> m_ns{};
+  std::vector<Frequency> m_frequencies{consts::red};
+  PropagationConfig m_config{};
  public:
   struct Metrics {
     std::vector<LightSource> sources;
@@ -18,7 +22,36 @@ class Chamber {
 
   void addSurface(Surface* surface);
 
-  void update();
+  // Replaces every surface by those of scene, which the chamber owns from
+  // now on, and takes its refractive indices and frequencies. The screen
+  // is added afterwards. Scenes come from presets or scenefile::read.
+  void load(Scene scene);
+
+  // Recomputes the hops from the first surface that changed since the
+  // last update, the fields before it are kept. A surface changed if its
+  // revision moved, if it took another place in z order, or if the
+  // refractive index in front of it did; new frequencies or a new
+  // propagation config recompute everything. The sin/cos tier is the
+  // exception: a hop computed with a tier at least as exact as the one
+  // asked for is kept, so a preview after a final render only recomputes
+  // what moved, and the render after it only what the preview did. Every
+  // surface it recomputes publishes its new field as a snapshot, as far
+  // as setCacheBytes() allows.
+  //
+  // Returns false if a parallel::Cancellation of the calling thread
+  // stopped it; the hops it did not finish are recomputed by the next
+  // update.
+  bool update();
+
+  // Fields the last surface would get at each of `planes` evenly spaced z
+  // behind the surface in front of it, up to its own z, as update() left
+  // the chamber. All planes are summed in one batched pass.
+  std::vector<Field> sweep(size_t planes) const;
+
+  // Side view of the last hop: nx points across the last surface through
+  // its middle, on nz planes spaced as in sweep(). Point k * nx + i is
+  // point i of plane k.
+  Field profile(size_t nx, size_t nz) const;
 
   void setZ(int n, Length z) {
     m_surfaces[n]->setZ(z);
@@ -29,15 +62,96 @@ class Chamber {
   }
 
   void setLight(Frequency f) {
-    m_frequency = f;
+    m_frequencies = {f};
+  }
+
+  // Every frequency becomes a channel of every surface, all of them are
+  // propagated in one pass.
+  void setLights(std::vector<Frequency> fs) {
+    m_frequencies = std::move(fs);
+  }
+
+  size_t channels() const {
+    return m_frequencies.size();
+  }
+
+  void setPropagation(const PropagationConfig& config) {
+    m_config = config;
+  }
+
+  const PropagationConfig& getPropagation() const {
+    return m_config;
+  }
+
+  // Cheap tiers for interactive updates, Exact for final renders.
+  void setSinCos(SinCos tier) {
+    m_config.sincos = tier;
+  }
+
+  // Fast algorithms are used on the hops they fit, the rest stays direct.
+  void setMethod(Method method) {
+    m_config.method = method;
+  }
+
+  // Mixed streams float amplitudes through the kernels; fields stay double.
+  void setPrecision(Precision precision) {
+    m_config.precision = precision;
+  }
+
+  // Memory for the snapshots of the fields that feed a hop, which let
+  // update() follow a power edit or a few moved points by superposition
+  // instead of summing the next hop again. A published field takes up to
+  // two copies, the snapshot and the spare of Published. From the light
+  // on, fields beyond the budget are not published and the hop behind
+  // them is summed in full. The last surface always publishes.
+  void setCacheBytes(size_t bytes) {
+    m_cacheBytes = bytes;
+  }
+
+  // Threads used by the propagation, 0 means all cores.
+  void setThreadCount(size_t threads);
+
+  // Forgets what the fields were computed from: the next update
+  // recomputes every hop, e.g. to time it.
+  void invalidate() {
+    m_computed = {};
   }
 
   void clear() {
     m_surfaces.clear();
     m_ns.clear();
+    m_owned.clear();
+    m_computed = {};
   }
 
   ~Chamber();
+
+ private:
+  std::vector<WavyEnvironment> environments(RefractiveIndex n) const;
+
+  // Evenly spaced z of n planes of the last hop, the last one excluded.
+  std::pair<LengthVal, LengthVal> lastHop(size_t planes) const;
+
+  // Surface i and everything its hop depends on, except the source field,
+  // are as they were computed.
+  bool unchanged(size_t i) const;
+
+  // Brings surface i up to date with a source field that changed by
+  // superposition since it was computed; false if it did not.
+  bool followSource(size_t i);
+
+  // What the fields were last computed from.
+  struct Computed {
+    std::vector<std::pair<const Surface*, uint64_t>> surfaces{};
+    std::vector<RefractiveIndex> ns{};
+    std::vector<Frequency> frequencies{};
+    PropagationConfig config{};
+    // Tier of the sin/cos each surface's field was computed with.
+    std::vector<SinCos> sincos{};
+    std::vector<std::shared_ptr<const Field>> fields{};
+  };
+  Computed m_computed{};
+  size_t m_cacheBytes = size_t{256} << 20;
 };
 
 }  // namespace phys
@@ -0,0 +1,85 @@
+#include "convolution.hpp"
+#include "fft.hpp"
+#include "lookup.hpp"
+#include "parallel.hpp"
+#include <cmath>
+
+namespace phys {
+namespace convolution {
+
+using fft::cplx;
+
+bool 
+applicable(const Field& src, const Field& dst) {
+  return lookup::applicable(src, dst);
+}
+
+bool 
+applicable(const Field& src, const GridLayout& to, double z) {
+  return lookup::applicable(src, to, z);
+}
+
+void 
+propagate(const Field& src, Field& dst, const kernels::Medium& medium) {
+  const GridLayout& from = *src.grid();
+  const GridLayout& to   = *dst.grid();
+
+  // Cell offsets to - from run over [-(from.n - 1), to.n - 1].
+  const size_t rows = fft::goodSize(from.nx + to.nx - 1);
+  const size_t cols = fft::goodSize(from.ny + to.ny - 1);
+  const fft::Plan2d plan(rows, cols);
+
+  const double norm = 1. / static_cast<double>(rows * cols);
+
+  std::vector<cplx> amplitudes(rows * cols);
+  std::vector<cplx> kernel(rows * cols);
+  for(size_t ch = 0; ch < medium.channels; ++ch) {
+    // Table row r holds the cell offset to - from of to.nx - 1 - r, and
+    // likewise for columns; offsets wrap around into the padded array.
+    const std::shared_ptr<const lookup::KernelTable> sampled = 
+        lookup::table(src, dst, medium.lambda[ch], medium.loss);
+    std::fill(kernel.begin(), kernel.end(), cplx{});
+    parallel::forRanges(sampled->rows(), 16, [&](size_t begin, size_t end) {
+      for(size_t r = begin; r < end; ++r) {
+        const size_t row = (to.nx - 1 + rows - r) % rows;
+        const double* re = sampled->re() + r * sampled->cols();
+        const double* im = sampled->im() + r * sampled->cols();
+        for(size_t c = 0; c < sampled->cols(); ++c) {
+          kernel[row * cols + (to.ny - 1 + cols - c) % cols] = {re[c], im[c]};
+        }
+      }
+    });
+
+    std::fill(amplitudes.begin(), amplitudes.end(), cplx{});
+    const double* re = src.re(ch);
+    const double* im = src.im(ch);
+    for(size_t p = 0; p < src.size(); ++p) {
+      const size_t cell = from.cell(p);
+      amplitudes[(cell / from.ny) * cols + cell % from.ny] = {re[p], im[p]};
+    }
+
+    plan.forward(kernel.data());
+    plan.forward(amplitudes.data());
+    parallel::forRanges(rows * cols, 1 << 14, [&](size_t begin, size_t end) {
+      for(size_t i = begin; i < end; ++i) {
+        const cplx a = amplitudes[i];
+        const cplx k = kernel[i];
+        amplitudes[i] = {(a.real() * k.real() - a.imag() * k.imag()) * norm, 
+                         (a.real() * k.imag() + a.imag() * k.real()) * norm};
+      }
+    });
+    plan.inverse(amplitudes.data());
+
+    double* outRe = dst.re(ch);
+    double* outIm = dst.im(ch);
+    for(size_t p = 0; p < dst.size(); ++p) {
+      const size_t cell = to.cell(p);
+      const cplx v = amplitudes[(cell / to.ny) * cols + cell % to.ny];
+      outRe[p] = v.real();
+      outIm[p] = v.imag();
+    }
+  }
+}
+
+}  // namespace convolution
+}  // namespace phys
@@ -0,0 +1,30 @@
+#ifndef ENGINE_CONVOLUTION_HPP
+#define ENGINE_CONVOLUTION_HPP
+
+#include "field.hpp"
+#include "kernels.hpp"
+
+// Grid-to-grid propagation as a convolution. When source and destination
+// are grids of the same pitch in parallel planes, the distance of a pair
+// depends only on the difference of their cells, so the Huygens sum is
+// the source grid convolved with the point-source kernel sampled on cell
+// offsets. Sampling is exact (no paraxial approximation): the result equals
+// the direct sum up to FFT rounding, in O(N^2 log N) instead of O(N^4).
+
+namespace phys {
+namespace convolution {
+
+// Both fields are grids of the same pitch in different planes.
+bool applicable(const Field& src, const Field& dst);
+
+// Same for a destination given only by its grid and plane.
+bool applicable(const Field& src, const GridLayout& to, double z);
+
+// Writes every channel of dst. Grids are zero-padded to at least the full
+// linear convolution, so nothing wraps around.
+void propagate(const Field& src, Field& dst, const kernels::Medium& medium);
+
+}  // namespace convolution
+}  // namespace phys
+
+#endif /* ENGINE_CONVOLUTION_HPP */
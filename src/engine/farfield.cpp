@@ -0,0 +1,423 @@
+#include "farfield.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+
+namespace phys {
+namespace farfield {
+
+namespace {
+
+using cplx = std::complex<double>;
+
+constexpr const size_t LeafSize = 32;
+
+inline cplx 
+polar(double phase) {
+  return {std::cos(phase), std::sin(phase)};
+}
+
+inline cplx 
+mul(cplx a, cplx b) {
+  return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+struct Node {
+  double x = 0.;
+  double y = 0.;
+  double z = 0.;
+  double radius = 0.;
+  std::array<double, 3> half{};
+  size_t begin = 0;
+  size_t end = 0;
+  int32_t left = -1;
+  int32_t right = -1;
+
+  bool leaf() const {return left < 0;}
+};
+
+// kd-tree split at the median of the longest side. Points are copied in
+// tree order so every node is a contiguous range.
+class Tree {
+ public:
+  Tree(const double* x, const double* y, const double* z, size_t n) 
+      : m_order(n), m_src{x, y, z} {
+    for(size_t i = 0; i < n; ++i) {
+      m_order[i] = static_cast<uint32_t>(i);
+    }
+    m_nodes.reserve(2 * n / LeafSize + 1);
+    build(0, n);
+
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+    for(size_t i = 0; i < n; ++i) {
+      m_x[i] = x[m_order[i]];
+      m_y[i] = y[m_order[i]];
+      m_z[i] = z[m_order[i]];
+    }
+  }
+
+  const Node& node(int32_t i) const {return m_nodes[static_cast<size_t>(i)];}
+
+  // Field index of tree position i.
+  size_t index(size_t i) const {return m_order[i];}
+
+  const double* xs() const {return m_x.data();}
+  const double* ys() const {return m_y.data();}
+  const double* zs() const {return m_z.data();}
+
+  // Disjoint subtrees covering every point, at least `count` of them unless
+  // the leaves run out first.
+  std::vector<int32_t> 
+  cover(size_t count) const {
+    std::vector<int32_t> nodes{0};
+    for(size_t i = 0; i < nodes.size() && nodes.size() < count; ) {
+      if(node(nodes[i]).leaf()) {
+        ++i;
+        continue;
+      }
+      int32_t split = nodes[i];
+      nodes[i] = node(split).left;
+      nodes.push_back(node(split).right);
+    }
+    return nodes;
+  }
+
+ private:
+  int32_t 
+  build(size_t begin, size_t end) {
+    std::array<double, 3> lo{ 1e300,  1e300,  1e300};
+    std::array<double, 3> hi{-1e300, -1e300, -1e300};
+    for(size_t i = begin; i < end; ++i) {
+      for(size_t a = 0; a < 3; ++a) {
+        lo[a] = std::min(lo[a], m_src[a][m_order[i]]);
+        hi[a] = std::max(hi[a], m_src[a][m_order[i]]);
+      }
+    }
+
+    Node node;
+    node.x = (lo[0] + hi[0]) / 2.;
+    node.y = (lo[1] + hi[1]) / 2.;
+    node.z = (lo[2] + hi[2]) / 2.;
+    for(size_t a = 0; a < 3; ++a) {
+      node.half[a] = (hi[a] - lo[a]) / 2.;
+    }
+    node.begin = begin;
+    node.end = end;
+    for(size_t i = begin; i < end; ++i) {
+      double dx = m_src[0][m_order[i]] - node.x;
+      double dy = m_src[1][m_order[i]] - node.y;
+      double dz = m_src[2][m_order[i]] - node.z;
+      node.radius = std::max(node.radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+
+    const int32_t self = static_cast<int32_t>(m_nodes.size());
+    m_nodes.push_back(node);
+    if(end - begin <= LeafSize) {
+      return self;
+    }
+
+    size_t axis = 0;
+    for(size_t a = 1; a < 3; ++a) {
+      if(hi[a] - lo[a] > hi[axis] - lo[axis]) {
+        axis = a;
+      }
+    }
+    const size_t mid = (begin + end) / 2;
+    const double* coord = m_src[axis];
+    std::nth_element(m_order.begin() + begin, m_order.begin() + mid, m_order.begin() + end, 
+                     [coord](uint32_t l, uint32_t r) {return coord[l] < coord[r];});
+
+    int32_t left  = build(begin, mid);
+    int32_t right = build(mid, end);
+    m_nodes[static_cast<size_t>(self)].left  = left;
+    m_nodes[static_cast<size_t>(self)].right = right;
+    return self;
+  }
+
+  std::vector<Node> m_nodes{};
+  std::vector<uint32_t> m_order;
+  std::array<const double*, 3> m_src;
+  std::vector<double> m_x{};
+  std::vector<double> m_y{};
+  std::vector<double> m_z{};
+};
+
+// Terms of the cross phase exp(-i c u.v) kept in a far pair: every
+// u1^i u2^j v1^i v2^j with i + j <= degree, (degree + 1)(degree + 2) / 2 of
+// them.
+constexpr const size_t MaxDegree = 12;
+constexpr const size_t MaxTerms  = (MaxDegree + 1) * (MaxDegree + 2) / 2;
+
+// Dual-tree walk accumulating into the destinations of one subtree.
+class Summation {
+ public:
+  Summation(const Tree& from, const Tree& to, const std::vector<std::vector<cplx>>& amplitudes, 
+            std::vector<std::vector<cplx>>& out, const kernels::Medium& medium, double tolerance)
+      : m_from(from), m_to(to), m_amplitudes(amplitudes), m_out(out), m_medium(medium), 
+        m_tolerance(tolerance), m_lambdaMin(*std::min_element(medium.lambda, medium.lambda + medium.channels)) {}
+
+  void 
+  pair(int32_t s, int32_t t) {
+    const Node& src = m_from.node(s);
+    const Node& dst = m_to.node(t);
+
+    Geometry g(src, dst);
+    size_t degree = far(src, dst, g);
+    const size_t terms = (degree + 1) * (degree + 2) / 2;
+    const size_t ns = src.end - src.begin;
+    const size_t nt = dst.end - dst.begin;
+    if(degree <= MaxDegree && (ns + nt) * terms < ns * nt) {
+      farPair(src, dst, g, degree);
+    } else if(src.leaf() && dst.leaf()) {
+      nearPair(src, dst);
+    } else if(dst.leaf() || (!src.leaf() && src.radius >= dst.radius)) {
+      pair(src.left, t);
+      pair(src.right, t);
+    } else {
+      pair(s, dst.left);
+      pair(s, dst.right);
+    }
+  }
+
+ private:
+  // Direction n between the cluster centres and two axes across it.
+  struct Geometry {
+    double r{};
+    std::array<double, 3> n{};
+    std::array<double, 3> e1{};
+    std::array<double, 3> e2{};
+
+    Geometry(const Node& src, const Node& dst) {
+      n = {dst.x - src.x, dst.y - src.y, dst.z - src.z};
+      r = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for(double& c : n) {
+        c /= r;
+      }
+
+      size_t least = 0;
+      for(size_t a = 1; a < 3; ++a) {
+        if(std::abs(n[a]) < std::abs(n[least])) {
+          least = a;
+        }
+      }
+      std::array<double, 3> axis{};
+      axis[least] = 1.;
+      e1 = cross(n, axis);
+      double len = std::sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
+      for(double& c : e1) {
+        c /= len;
+      }
+      e2 = cross(n, e1);
+    }
+
+    static std::array<double, 3> 
+    cross(const std::array<double, 3>& a, const std::array<double, 3>& b) {
+      return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+    }
+
+    static double 
+    dot(const std::array<double, 3>& a, double x, double y, double z) {
+      return a[0] * x + a[1] * y + a[2] * z;
+    }
+  };
+
+  // Smallest Taylor degree of the cross phase meeting the tolerance,
+  // MaxDegree + 1 if the pair cannot be taken far. Besides the truncation
+  // x^(d+1) / (d+1)! with x = ab / (R lambda), the expansion drops the
+  // cubic path term (n.e) |e_perp|^2 / 2R^2 and the second order of 1/l.
+  size_t 
+  far(const Node& src, const Node& dst, const Geometry& g) const {
+    const double rho = src.radius + dst.radius;
+    if(g.r <= rho) {
+      return MaxDegree + 1;
+    }
+
+    double along = 0.;
+    for(size_t a = 0; a < 3; ++a) {
+      along += std::abs(g.n[a]) * (src.half[a] + dst.half[a]);
+    }
+    const double cubic = along * rho * rho / (2. * g.r * g.r * m_lambdaMin);
+    const double amplitude = (rho / g.r) * (rho / g.r);
+    if(std::max(cubic, amplitude) > m_tolerance / 2.) {
+      return MaxDegree + 1;
+    }
+
+    const double x = src.radius * dst.radius / (g.r * m_lambdaMin);
+    double term = x;
+    for(size_t degree = 0; degree <= MaxDegree; ++degree) {
+      if(term <= m_tolerance / 2.) {
+        return degree;
+      }
+      term *= x / static_cast<double>(degree + 2);
+    }
+    return MaxDegree + 1;
+  }
+
+  // With u = s - c and v = t - d split into along n and across it (u1, u2
+  // on e1, e2), the sources of the cluster are reduced to the moments
+  //   M[i][j] = sum a_s exp(i (|u_perp|^2 / 2R - n.u) / lambda) (1 + n.u / R) u1^i u2^j
+  // and every destination evaluates
+  //   exp(i (R + n.v + |v_perp|^2 / 2R) / lambda) (1 - n.v / R) loss / R
+  //   * sum (-i / (R lambda))^(i+j) / (i! j!) M[i][j] v1^i v2^j
+  // Coordinates are scaled by the cluster radii to keep powers near one.
+  void 
+  farPair(const Node& src, const Node& dst, const Geometry& g, size_t degree) {
+    const size_t channels = m_medium.channels;
+    const double r = g.r;
+    const double a = std::max(src.radius, 1e-300);
+    const double b = std::max(dst.radius, 1e-300);
+
+    auto index = [degree](size_t i, size_t j) {return i * (degree + 1) - i * (i - 1) / 2 + j;};
+    const size_t terms = index(degree, 0) + 1;
+
+    std::array<double, MaxDegree + 1> p1;
+    std::array<double, MaxDegree + 1> p2;
+    auto powers = [&](double u1, double u2) {
+      p1[0] = p2[0] = 1.;
+      for(size_t k = 1; k <= degree; ++k) {
+        p1[k] = p1[k - 1] * u1;
+        p2[k] = p2[k - 1] * u2;
+      }
+    };
+
+    std::vector<cplx> moments(channels * terms);
+    for(size_t s = src.begin; s < src.end; ++s) {
+      const double x = m_from.xs()[s] - src.x;
+      const double y = m_from.ys()[s] - src.y;
+      const double z = m_from.zs()[s] - src.z;
+      const double along = Geometry::dot(g.n, x, y, z);
+      const double u1 = Geometry::dot(g.e1, x, y, z);
+      const double u2 = Geometry::dot(g.e2, x, y, z);
+      const double path = (u1 * u1 + u2 * u2) / (2. * r) - along;
+      const double amp = 1. + along / r;
+      powers(u1 / a, u2 / a);
+      for(size_t ch = 0; ch < channels; ++ch) {
+        const cplx w = mul(m_amplitudes[ch][s], polar(path / m_medium.lambda[ch])) * amp;
+        cplx* m = moments.data() + ch * terms;
+        for(size_t i = 0; i <= degree; ++i) {
+          const cplx wi = w * p1[i];
+          for(size_t j = 0; i + j <= degree; ++j) {
+            m[index(i, j)] += wi * p2[j];
+          }
+        }
+      }
+    }
+
+    // Fold the coefficients and the centre-to-centre term into the moments.
+    for(size_t ch = 0; ch < channels; ++ch) {
+      const double lambda = m_medium.lambda[ch];
+      const cplx step{0., -a * b / (r * lambda)};
+      const cplx centre = polar(r / lambda) * (m_medium.loss / r);
+      std::array<cplx, MaxDegree + 1> power;
+      power[0] = centre;
+      for(size_t k = 1; k <= degree; ++k) {
+        power[k] = mul(power[k - 1], step) / static_cast<double>(k);
+      }
+      cplx* m = moments.data() + ch * terms;
+      for(size_t i = 0; i <= degree; ++i) {
+        for(size_t j = 0; i + j <= degree; ++j) {
+          // (-i c a b)^(i+j) / (i! j!) from the running (i+j)! products.
+          double binomial = 1.;
+          for(size_t k = 1; k <= j; ++k) {
+            binomial = binomial * static_cast<double>(i + k) / static_cast<double>(k);
+          }
+          m[index(i, j)] = mul(m[index(i, j)], power[i + j]) * binomial;
+        }
+      }
+    }
+
+    for(size_t t = dst.begin; t < dst.end; ++t) {
+      const double x = m_to.xs()[t] - dst.x;
+      const double y = m_to.ys()[t] - dst.y;
+      const double z = m_to.zs()[t] - dst.z;
+      const double along = Geometry::dot(g.n, x, y, z);
+      const double v1 = Geometry::dot(g.e1, x, y, z);
+      const double v2 = Geometry::dot(g.e2, x, y, z);
+      const double path = (v1 * v1 + v2 * v2) / (2. * r) + along;
+      const double amp = 1. - along / r;
+      powers(v1 / b, v2 / b);
+      for(size_t ch = 0; ch < channels; ++ch) {
+        const cplx* m = moments.data() + ch * terms;
+        cplx sum{};
+        for(size_t i = 0; i <= degree; ++i) {
+          cplx row{};
+          for(size_t j = 0; i + j <= degree; ++j) {
+            row += m[index(i, j)] * p2[j];
+          }
+          sum += row * p1[i];
+        }
+        m_out[ch][t] += mul(sum, polar(path / m_medium.lambda[ch])) * amp;
+      }
+    }
+  }
+
+  // Same pair term as kernels::scalar.
+  void 
+  nearPair(const Node& src, const Node& dst) {
+    for(size_t t = dst.begin; t < dst.end; ++t) {
+      for(size_t s = src.begin; s < src.end; ++s) {
+        double x = m_from.xs()[s] - m_to.xs()[t];
+        double y = m_from.ys()[s] - m_to.ys()[t];
+        double z = m_from.zs()[s] - m_to.zs()[t];
+        double l = std::sqrt(x * x + y * y + z * z);
+        double amp = m_medium.loss / l;
+        for(size_t ch = 0; ch < m_medium.channels; ++ch) {
+          m_out[ch][t] += mul(m_amplitudes[ch][s], polar(l / m_medium.lambda[ch])) * amp;
+        }
+      }
+    }
+  }
+
+  const Tree& m_from;
+  const Tree& m_to;
+  const std::vector<std::vector<cplx>>& m_amplitudes;
+  std::vector<std::vector<cplx>>& m_out;
+  const kernels::Medium& m_medium;
+  double m_tolerance;
+  double m_lambdaMin;
+};
+
+}  // namespace
+
+void 
+propagate(const Field& src, Field& dst, const kernels::Medium& medium, double tolerance) {
+  if(src.empty() || dst.empty()) {
+    return;
+  }
+
+  const Tree from(src.xs(), src.ys(), src.zs(), src.size());
+  const Tree to(dst.xs(), dst.ys(), dst.zs(), dst.size());
+
+  std::vector<std::vector<cplx>> amplitudes(medium.channels, std::vector<cplx>(src.size()));
+  std::vector<std::vector<cplx>> out(medium.channels, std::vector<cplx>(dst.size()));
+  for(size_t ch = 0; ch < medium.channels; ++ch) {
+    for(size_t i = 0; i < src.size(); ++i) {
+      amplitudes[ch][i] = {src.re(ch)[from.index(i)], src.im(ch)[from.index(i)]};
+    }
+  }
+
+  // Destination subtrees are disjoint, so tasks never write the same point.
+  const std::vector<int32_t> roots = to.cover(4 * parallel::threadCount());
+  parallel::forRanges(roots.size(), 1, [&](size_t begin, size_t end) {
+    Summation summation(from, to, amplitudes, out, medium, tolerance);
+    for(size_t r = begin; r < end; ++r) {
+      summation.pair(0, roots[r]);
+    }
+  });
+
+  for(size_t ch = 0; ch < medium.channels; ++ch) {
+    double* re = dst.re(ch);
+    double* im = dst.im(ch);
+    for(size_t i = 0; i < dst.size(); ++i) {
+      re[to.index(i)] = out[ch][i].real();
+      im[to.index(i)] = out[ch][i].imag();
+    }
+  }
+}
+
+}  // namespace farfield
+}  // namespace phys
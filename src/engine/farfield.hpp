@@ -0,0 +1,32 @@
+#ifndef ENGINE_FARFIELD_HPP
+#define ENGINE_FARFIELD_HPP
+
+#include "field.hpp"
+#include "kernels.hpp"
+
+// Tree summation for unstructured sources, where the grid methods do not
+// apply. Sources and destinations are split into kd-trees of clusters.
+// For a source cluster (centre c, radius a) and a destination cluster
+// (centre d, radius b) at distance R, with offsets s = c + u, t = d + v and
+// n = (d - c) / R, the path expands as
+//   l = R + (n.v + |v_perp|^2 / 2R) + (-n.u + |u_perp|^2 / 2R) - u_perp.v_perp / R + ...
+// Every term but the cross one (at most ab / R) belongs to one side only.
+// The cross phase is kept as a Taylor series in u_perp.v_perp, so the
+// cluster reduces its sources to a few moments and every destination
+// evaluates the series against them. The cost of the pair falls from
+// |S| |T| to (|S| + |T|) times the number of terms.
+//
+// Pairs are taken far once the estimated error of their terms, in
+// radians of phase and relative amplitude, is below the tolerance;
+// closer pairs are split further and summed directly at the leaves.
+
+namespace phys {
+namespace farfield {
+
+// Writes every channel of dst.
+void propagate(const Field& src, Field& dst, const kernels::Medium& medium, double tolerance);
+
+}  // namespace farfield
+}  // namespace phys
+
+#endif /* ENGINE_FARFIELD_HPP */
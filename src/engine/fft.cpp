@@ -0,0 +1,113 @@
+#include "fft.hpp"
+#include "parallel.hpp"
+#include "trig.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace phys {
+namespace fft {
+
+size_t 
+goodSize(size_t n) {
+  size_t size = 1;
+  while(size < n) {
+    size <<= 1;
+  }
+  return size;
+}
+
+Plan::Plan(size_t n) : m_n(n), m_twiddles(n / 2), m_reversed(n) {
+  if(n == 0 || (n & (n - 1)) != 0) {
+    std::cerr << "FFT length " << n << " is not a power of two\n";
+    abort();
+  }
+
+  for(size_t k = 0; k < n / 2; ++k) {
+    double phase = -trig::TwoPi * static_cast<double>(k) / static_cast<double>(n);
+    m_twiddles[k] = {std::cos(phase), std::sin(phase)};
+  }
+
+  size_t bits = 0;
+  while((size_t{1} << bits) < n) {
+    ++bits;
+  }
+  for(size_t i = 0; i < n; ++i) {
+    uint32_t r = 0;
+    for(size_t b = 0; b < bits; ++b) {
+      r |= static_cast<uint32_t>(((i >> b) & 1) << (bits - 1 - b));
+    }
+    m_reversed[i] = r;
+  }
+}
+
+void 
+Plan::run(cplx* data, bool inverse) const {
+  for(size_t i = 0; i < m_n; ++i) {
+    if(i < m_reversed[i]) {
+      std::swap(data[i], data[m_reversed[i]]);
+    }
+  }
+
+  // Products are spelled out: std::complex multiplication checks for
+  // infinities and does not vectorise.
+  const double sign = inverse ? -1. : 1.;
+  for(size_t len = 2; len <= m_n; len <<= 1) {
+    const size_t half = len / 2;
+    const size_t step = m_n / len;
+    for(size_t i = 0; i < m_n; i += len) {
+      for(size_t k = 0; k < half; ++k) {
+        const cplx w = m_twiddles[k * step];
+        const double wr = w.real();
+        const double wi = sign * w.imag();
+        cplx& a = data[i + k];
+        cplx& b = data[i + k + half];
+        double vr = b.real() * wr - b.imag() * wi;
+        double vi = b.real() * wi + b.imag() * wr;
+        b = {a.real() - vr, a.imag() - vi};
+        a = {a.real() + vr, a.imag() + vi};
+      }
+    }
+  }
+}
+
+void 
+Plan2d::run(cplx* data, bool inverse) const {
+  const size_t rows = this->rows();
+  const size_t cols = this->cols();
+
+  parallel::forRanges(rows, 8, [&](size_t begin, size_t end) {
+    for(size_t r = begin; r < end; ++r) {
+      inverse ? m_alongRows.inverse(data + r * cols) : m_alongRows.forward(data + r * cols);
+    }
+  });
+
+  // Columns are gathered a few at a time so every cache line of a row is
+  // used while it is loaded.
+  constexpr const size_t Block = 8;
+  const size_t blocks = (cols + Block - 1) / Block;
+  parallel::forRanges(blocks, 1, [&](size_t begin, size_t end) {
+    std::vector<cplx> column(Block * rows);
+    for(size_t b = begin; b < end; ++b) {
+      const size_t c0 = b * Block;
+      const size_t width = std::min(Block, cols - c0);
+      for(size_t r = 0; r < rows; ++r) {
+        for(size_t c = 0; c < width; ++c) {
+          column[c * rows + r] = data[r * cols + c0 + c];
+        }
+      }
+      for(size_t c = 0; c < width; ++c) {
+        inverse ? m_alongCols.inverse(column.data() + c * rows) 
+                : m_alongCols.forward(column.data() + c * rows);
+      }
+      for(size_t r = 0; r < rows; ++r) {
+        for(size_t c = 0; c < width; ++c) {
+          data[r * cols + c0 + c] = column[c * rows + r];
+        }
+      }
+    }
+  });
+}
+
+}  // namespace fft
+}  // namespace phys
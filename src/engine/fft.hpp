@@ -0,0 +1,60 @@
+#ifndef ENGINE_FFT_HPP
+#define ENGINE_FFT_HPP
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace phys {
+namespace fft {
+
+using cplx = std::complex<double>;
+
+// Smallest power of two not below n.
+size_t goodSize(size_t n);
+
+// Radix-2 transform of one length, twiddles and bit reversal precomputed.
+// Forward is exp(-2 pi i kn / N); inverse is not normalised.
+class Plan {
+ public:
+  explicit Plan(size_t n);
+
+  size_t size() const {return m_n;}
+
+  void forward(cplx* data) const {run(data, false);}
+
+  void inverse(cplx* data) const {run(data, true);}
+
+ private:
+  void run(cplx* data, bool inverse) const;
+
+  size_t m_n;
+  std::vector<cplx> m_twiddles;
+  std::vector<uint32_t> m_reversed;
+};
+
+// In-place 2D transforms of a row-major rows x cols array; rows and columns
+// are spread over the parallel pool.
+class Plan2d {
+ public:
+  Plan2d(size_t rows, size_t cols) : m_alongRows(cols), m_alongCols(rows) {}
+
+  size_t rows() const {return m_alongCols.size();}
+  size_t cols() const {return m_alongRows.size();}
+
+  void forward(cplx* data) const {run(data, false);}
+
+  void inverse(cplx* data) const {run(data, true);}
+
+ private:
+  void run(cplx* data, bool inverse) const;
+
+  Plan m_alongRows;
+  Plan m_alongCols;
+};
+
+}  // namespace fft
+}  // namespace phys
+
+#endif /* ENGINE_FFT_HPP */
@@ -0,0 +1,138 @@
+#include "field.hpp"
+
+namespace phys {
+
+template <typename Real>
+void 
+BasicField<Real>::reserve(size_t n) {
+  m_x.reserve(n);
+  m_y.reserve(n);
+  m_z.reserve(n);
+  for(size_t c = 0; c < channels(); ++c) {
+    m_re[c].reserve(n);
+    m_im[c].reserve(n);
+  }
+}
+
+template <typename Real>
+void 
+BasicField<Real>::clear() {
+  m_x.clear();
+  m_y.clear();
+  m_z.clear();
+  for(size_t c = 0; c < channels(); ++c) {
+    m_re[c].clear();
+    m_im[c].clear();
+  }
+  m_grid.reset();
+}
+
+template <typename Real>
+void 
+BasicField<Real>::setChannels(size_t channels) {
+  if(channels == 0 || channels > MaxChannels) {
+    std::cerr << "Field supports from 1 to " << MaxChannels << " channels\n";
+    abort();
+  }
+  m_re.resize(channels, m_re.front());
+  m_im.resize(channels, m_im.front());
+}
+
+template <typename Real>
+void 
+BasicField<Real>::push(const EWave& wave, const Position& pos) {
+  m_x.push_back(pos.X()->getVal());
+  m_y.push_back(pos.Y()->getVal());
+  m_z.push_back(pos.Z()->getVal());
+  for(size_t c = 0; c < channels(); ++c) {
+    m_re[c].push_back(static_cast<Real>(wave.getComplex().X()->getVal()));
+    m_im[c].push_back(static_cast<Real>(wave.getComplex().Y()->getVal()));
+  }
+  m_grid.reset();
+}
+
+template <typename Real>
+void 
+BasicField<Real>::append(const double* x, const double* y, const double* z, size_t n) {
+  m_x.insert(m_x.end(), x, x + n);
+  m_y.insert(m_y.end(), y, y + n);
+  m_z.insert(m_z.end(), z, z + n);
+  for(size_t c = 0; c < channels(); ++c) {
+    m_re[c].resize(m_x.size());
+    m_im[c].resize(m_x.size());
+  }
+  m_grid.reset();
+}
+
+template <typename Real>
+void 
+BasicField<Real>::setGrid(GridLayout grid) {
+  if(grid.points() != size()) {
+    std::cerr << "Grid layout describes " << grid.points() << " points, field has " << size() << "\n";
+    abort();
+  }
+  m_grid = std::make_shared<const GridLayout>(std::move(grid));
+}
+
+template <typename Real>
+void 
+BasicField<Real>::setPosition(size_t i, const Position& pos) {
+  m_x[i] = pos.X()->getVal();
+  m_y[i] = pos.Y()->getVal();
+  m_z[i] = pos.Z()->getVal();
+  m_grid.reset();
+}
+
+template <typename Real>
+void 
+BasicField<Real>::setWave(size_t i, size_t channel, const EWave& wave) {
+  m_re[channel][i] = static_cast<Real>(wave.getComplex().X()->getVal());
+  m_im[channel][i] = static_cast<Real>(wave.getComplex().Y()->getVal());
+}
+
+template <typename Real>
+void 
+BasicField<Real>::setWave(size_t i, const EWave& wave) {
+  for(size_t c = 0; c < channels(); ++c) {
+    setWave(i, c, wave);
+  }
+}
+
+template <typename Real>
+void 
+BasicField<Real>::setZ(LengthVal z) {
+  m_z.assign(m_z.size(), z->getVal());
+}
+
+template <typename Real>
+void 
+BasicField<Real>::shiftZ(LengthVal dz) {
+  for(double& z : m_z) {
+    z += dz->getVal();
+  }
+}
+
+template <typename Real>
+void 
+BasicField<Real>::clearWaves() {
+  for(size_t c = 0; c < channels(); ++c) {
+    m_re[c].assign(size(), Real{});
+    m_im[c].assign(size(), Real{});
+  }
+}
+
+template <typename Real>
+std::vector<LightSource> 
+BasicField<Real>::sources() const {
+  std::vector<LightSource> out;
+  out.reserve(size());
+  for(size_t i = 0; i < size(); ++i) {
+    out.emplace_back(wave(i), position(i));
+  }
+  return out;
+}
+
+template class BasicField<double>;
+template class BasicField<float>;
+
+}  // namespace phys
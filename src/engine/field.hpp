@@ -0,0 +1,160 @@
+#ifndef ENGINE_FIELD_HPP
+#define ENGINE_FIELD_HPP
+
+#include "grid.hpp"
+#include "units.hpp"
+#include "wave.hpp"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace phys {
+
+using LightSource = std::pair<EWave, Position>;
+
+template <typename T, std::size_t Align = 64>
+struct AlignedAllocator {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Align>;
+  };
+
+  AlignedAllocator() = default;
+
+  template <typename U>
+  constexpr AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+  }
+
+  void deallocate(T* p, std::size_t) noexcept {
+    ::operator delete(p, std::align_val_t{Align});
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Align>&) const noexcept {
+    return true;
+  }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Structure-of-arrays storage of point sources: every coordinate and both
+// parts of the complex amplitude live in their own cache-line aligned array,
+// so kernels can stream them independently. A field carries one complex
+// amplitude per channel (wavelength) for every point.
+//
+// Amplitudes are stored as Real. Positions are always double: at metre-scale
+// distances float coordinates are off by a fraction of a wavelength.
+template <typename Real>
+class BasicField {
+ public:
+  using real_t = Real;
+
+  static constexpr const size_t MaxChannels = 64;
+
+  BasicField() : m_re(1), m_im(1) {}
+
+  // Same points and amplitudes converted to Real.
+  template <typename Other>
+  explicit BasicField(const BasicField<Other>& other);
+
+  size_t size() const {return m_x.size();}
+
+  bool empty() const {return m_x.empty();}
+
+  void reserve(size_t n);
+
+  void clear();
+
+  size_t channels() const {return m_re.size();}
+
+  // New channels start as copies of channel 0.
+  void setChannels(size_t channels);
+
+  // Adds a point carrying the same wave in every channel. Drops the grid
+  // layout, call setGrid() once all points are in.
+  void push(const EWave& wave, const Position& pos);
+
+  // Adds n dark points at (x[k], y[k], z[k]). Drops the grid layout too.
+  void append(const double* x, const double* y, const double* z, size_t n);
+
+  // Regular grid the points lie on, nullptr if none is known.
+  const GridLayout* grid() const {return m_grid.get();}
+
+  void setGrid(GridLayout grid);
+
+  Position position(size_t i) const {
+    return {LengthVal{m_x[i]}, LengthVal{m_y[i]}, LengthVal{m_z[i]}};
+  }
+
+  void setPosition(size_t i, const Position& pos);
+
+  EWave wave(size_t i, size_t channel = 0) const {
+    return EWave{Complex<EFieldVal>{EFieldVal{static_cast<double>(m_re[channel][i])}, 
+                                    EFieldVal{static_cast<double>(m_im[channel][i])}}};
+  }
+
+  void setWave(size_t i, size_t channel, const EWave& wave);
+
+  // Same wave in every channel.
+  void setWave(size_t i, const EWave& wave);
+
+  void setZ(LengthVal z);
+
+  // Moves every point by dz along z.
+  void shiftZ(LengthVal dz);
+
+  // Zeroes every amplitude, keeping positions.
+  void clearWaves();
+
+  const double* xs() const {return m_x.data();}
+  const double* ys() const {return m_y.data();}
+  const double* zs() const {return m_z.data();}
+  const Real* re(size_t channel = 0) const {return m_re[channel].data();}
+  const Real* im(size_t channel = 0) const {return m_im[channel].data();}
+
+  Real* re(size_t channel = 0) {return m_re[channel].data();}
+  Real* im(size_t channel = 0) {return m_im[channel].data();}
+
+  // Array-of-structures copy of channel 0 for code that still walks
+  // LightSource records, built on every call.
+  std::vector<LightSource> sources() const;
+
+ private:
+  template <typename> friend class BasicField;
+
+  AlignedVector<double> m_x{};
+  AlignedVector<double> m_y{};
+  AlignedVector<double> m_z{};
+  std::vector<AlignedVector<Real>> m_re;
+  std::vector<AlignedVector<Real>> m_im;
+
+  std::shared_ptr<const GridLayout> m_grid{};
+};
+
+template <typename Real>
+template <typename Other>
+BasicField<Real>::BasicField(const BasicField<Other>& other)
+    : m_x(other.m_x), m_y(other.m_y), m_z(other.m_z), 
+      m_re(other.channels()), m_im(other.channels()), m_grid(other.m_grid) {
+  for(size_t c = 0; c < channels(); ++c) {
+    m_re[c].assign(other.m_re[c].begin(), other.m_re[c].end());
+    m_im[c].assign(other.m_im[c].begin(), other.m_im[c].end());
+  }
+}
+
+extern template class BasicField<double>;
+extern template class BasicField<float>;
+
+using Field  = BasicField<double>;
+using FieldF = BasicField<float>;
+
+}  // namespace phys
+
+#endif /* ENGINE_FIELD_HPP */
@@ -0,0 +1,272 @@
+#include "fresnel.hpp"
+#include "fft.hpp"
+#include "parallel.hpp"
+#include "raw.hpp"
+#include <cmath>
+
+namespace phys {
+namespace fresnel {
+
+using fft::cplx;
+
+namespace {
+
+inline cplx 
+polar(double phase) {
+  return {std::cos(phase), std::sin(phase)};
+}
+
+inline cplx 
+mul(cplx a, cplx b) {
+  return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+// out[p] = sum_i in[i] exp(-i theta p i) for p < m, i < n. With
+// p i = (p^2 + i^2 - (p - i)^2) / 2 the sum becomes a convolution with the
+// chirp exp(i theta k^2 / 2), done by FFT in the next power of two above
+// n + m - 1.
+class Bluestein {
+ public:
+  Bluestein(size_t n, size_t m, double theta) 
+      : m_n(n), m_m(m), m_plan(fft::goodSize(n + m - 1)), m_chirp(std::max(n, m)) {
+    for(size_t k = 0; k < m_chirp.size(); ++k) {
+      double k2 = static_cast<double>(k) * static_cast<double>(k);
+      m_chirp[k] = polar(-theta * k2 / 2.);
+    }
+
+    const size_t size = m_plan.size();
+    m_filter.assign(size, cplx{});
+    for(size_t k = 0; k < m; ++k) {
+      m_filter[k] = std::conj(m_chirp[k]);
+    }
+    for(size_t k = 1; k < n; ++k) {
+      m_filter[size - k] = std::conj(m_chirp[k]);
+    }
+    m_plan.forward(m_filter.data());
+    const double norm = 1. / static_cast<double>(size);
+    for(cplx& f : m_filter) {
+      f *= norm;
+    }
+  }
+
+  size_t workSize() const {return m_plan.size();}
+
+  void 
+  apply(const cplx* in, size_t inStride, cplx* out, size_t outStride, cplx* work) const {
+    const size_t size = m_plan.size();
+    for(size_t i = 0; i < m_n; ++i) {
+      work[i] = mul(in[i * inStride], m_chirp[i]);
+    }
+    std::fill(work + m_n, work + size, cplx{});
+
+    m_plan.forward(work);
+    for(size_t k = 0; k < size; ++k) {
+      work[k] = mul(work[k], m_filter[k]);
+    }
+    m_plan.inverse(work);
+
+    for(size_t p = 0; p < m_m; ++p) {
+      out[p * outStride] = mul(work[p], m_chirp[p]);
+    }
+  }
+
+ private:
+  size_t m_n;
+  size_t m_m;
+  fft::Plan m_plan;
+  std::vector<cplx> m_chirp;
+  std::vector<cplx> m_filter{};
+};
+
+// Per-axis phases of the expansion. For source coordinate u_i = u0 + i du
+// and destination x_p = x0 + p dx:
+//   (x - u)^2 / 2 = (u^2 / 2 - x0 u) + (x^2 / 2 - x u0) + x0 u0 - p i du dx
+// The first two go before and after the transform, the last one is the
+// transform itself.
+struct Axis {
+  std::vector<cplx> before;
+  std::vector<cplx> after;
+  double constant;
+  double theta;
+
+  Axis(double u0, double du, size_t n, double x0, double dx, size_t m, double c) 
+      : before(n), after(m), constant(c * x0 * u0), theta(c * du * dx) {
+    for(size_t i = 0; i < n; ++i) {
+      double u = u0 + static_cast<double>(i) * du;
+      before[i] = polar(c * (u * u / 2. - x0 * u));
+    }
+    for(size_t p = 0; p < m; ++p) {
+      double x = x0 + static_cast<double>(p) * dx;
+      after[p] = polar(c * (x * x / 2. - x * u0));
+    }
+  }
+};
+
+}  // namespace
+
+bool 
+applicable(const Field& src, const Field& dst) {
+  return dst.grid() != nullptr && applicable(src, *dst.grid(), dst.zs()[0]);
+}
+
+bool 
+applicable(const Field& src, const GridLayout&, double z) {
+  return src.grid() != nullptr && !raw::same(src.zs()[0], z);
+}
+
+namespace {
+
+double 
+phaseError(const raw::Box& from, const raw::Box& to, double lambda) {
+  const double rx = std::max(std::abs(to.hi.x - from.lo.x), std::abs(from.hi.x - to.lo.x));
+  const double ry = std::max(std::abs(to.hi.y - from.lo.y), std::abs(from.hi.y - to.lo.y));
+  const double r2 = rx * rx + ry * ry;
+  const double z  = std::abs(from.lo.z - to.lo.z);
+  return r2 * r2 / (8. * z * z * z * lambda);
+}
+
+}  // namespace
+
+double 
+phaseError(const Field& src, const Field& dst, double lambda) {
+  return phaseError(raw::bounds(src), raw::bounds(dst), lambda);
+}
+
+double 
+phaseError(const Field& src, const GridLayout& to, double z, double lambda) {
+  return phaseError(raw::bounds(src), raw::bounds(to, z), lambda);
+}
+
+void 
+chirpz(const Field& src, Field& dst, const kernels::Medium& medium) {
+  const GridLayout& from = *src.grid();
+  const GridLayout& to   = *dst.grid();
+  const double z = std::abs(src.zs()[0] - dst.zs()[0]);
+
+  // Source grid, then rows transformed along y, then columns along x.
+  std::vector<cplx> grid(from.nx * from.ny);
+  std::vector<cplx> rows(from.nx * to.ny);
+  std::vector<cplx> out(to.nx * to.ny);
+
+  for(size_t ch = 0; ch < medium.channels; ++ch) {
+    const double lambda = medium.lambda[ch];
+    const double c = 1. / (z * lambda);
+    const Axis ax(from.x0, from.dx, from.nx, to.x0, to.dx, to.nx, c);
+    const Axis ay(from.y0, from.dy, from.ny, to.y0, to.dy, to.ny, c);
+    const Bluestein alongX(from.nx, to.nx, ax.theta);
+    const Bluestein alongY(from.ny, to.ny, ay.theta);
+
+    std::fill(grid.begin(), grid.end(), cplx{});
+    const double* re = src.re(ch);
+    const double* im = src.im(ch);
+    for(size_t p = 0; p < src.size(); ++p) {
+      const size_t cell = from.cell(p);
+      const size_t i = cell / from.ny;
+      const size_t j = cell % from.ny;
+      grid[cell] = mul(cplx{re[p], im[p]}, mul(ax.before[i], ay.before[j]));
+    }
+
+    parallel::forRanges(from.nx, 4, [&](size_t begin, size_t end) {
+      std::vector<cplx> work(alongY.workSize());
+      for(size_t i = begin; i < end; ++i) {
+        alongY.apply(grid.data() + i * from.ny, 1, rows.data() + i * to.ny, 1, work.data());
+      }
+    });
+    parallel::forRanges(to.ny, 4, [&](size_t begin, size_t end) {
+      std::vector<cplx> work(alongX.workSize());
+      for(size_t q = begin; q < end; ++q) {
+        alongX.apply(rows.data() + q, to.ny, out.data() + q, to.ny, work.data());
+      }
+    });
+
+    const cplx global = polar(z / lambda + ax.constant + ay.constant) * (medium.loss / z);
+    double* outRe = dst.re(ch);
+    double* outIm = dst.im(ch);
+    for(size_t p = 0; p < dst.size(); ++p) {
+      const size_t cell = to.cell(p);
+      const cplx v = mul(out[cell], mul(global, mul(ax.after[cell / to.ny], ay.after[cell % to.ny])));
+      outRe[p] = v.real();
+      outIm[p] = v.imag();
+    }
+  }
+}
+
+void 
+separable(const Field& src, Field& dst, const kernels::Medium& medium) {
+  const GridLayout& from = *src.grid();
+  const GridLayout& to   = *dst.grid();
+  const double z = std::abs(src.zs()[0] - dst.zs()[0]);
+
+  // Source grid, then rows multiplied by Ay^T, then Ax times that.
+  std::vector<cplx> grid(from.nx * from.ny);
+  std::vector<cplx> rows(from.nx * to.ny);
+  std::vector<cplx> out(to.nx * to.ny);
+
+  auto chirps = [](double u0, double du, size_t n, double x0, double dx, size_t m, double c) {
+    std::vector<cplx> matrix(m * n);
+    for(size_t p = 0; p < m; ++p) {
+      const double x = x0 + static_cast<double>(p) * dx;
+      for(size_t i = 0; i < n; ++i) {
+        const double d = x - (u0 + static_cast<double>(i) * du);
+        matrix[p * n + i] = polar(c * d * d / 2.);
+      }
+    }
+    return matrix;
+  };
+
+  for(size_t ch = 0; ch < medium.channels; ++ch) {
+    const double lambda = medium.lambda[ch];
+    const double c = 1. / (z * lambda);
+    const std::vector<cplx> ax = chirps(from.x0, from.dx, from.nx, to.x0, to.dx, to.nx, c);
+    const std::vector<cplx> ay = chirps(from.y0, from.dy, from.ny, to.y0, to.dy, to.ny, c);
+
+    std::fill(grid.begin(), grid.end(), cplx{});
+    const double* re = src.re(ch);
+    const double* im = src.im(ch);
+    for(size_t p = 0; p < src.size(); ++p) {
+      grid[from.cell(p)] = {re[p], im[p]};
+    }
+
+    parallel::forRanges(from.nx, 4, [&](size_t begin, size_t end) {
+      for(size_t i = begin; i < end; ++i) {
+        const cplx* g = grid.data() + i * from.ny;
+        for(size_t q = 0; q < to.ny; ++q) {
+          const cplx* a = ay.data() + q * from.ny;
+          double sumRe = 0.;
+          double sumIm = 0.;
+          for(size_t j = 0; j < from.ny; ++j) {
+            sumRe += g[j].real() * a[j].real() - g[j].imag() * a[j].imag();
+            sumIm += g[j].real() * a[j].imag() + g[j].imag() * a[j].real();
+          }
+          rows[i * to.ny + q] = {sumRe, sumIm};
+        }
+      }
+    });
+
+    parallel::forRanges(to.nx, 4, [&](size_t begin, size_t end) {
+      for(size_t p = begin; p < end; ++p) {
+        cplx* o = out.data() + p * to.ny;
+        std::fill(o, o + to.ny, cplx{});
+        for(size_t i = 0; i < from.nx; ++i) {
+          const cplx a = ax[p * from.nx + i];
+          const cplx* r = rows.data() + i * to.ny;
+          for(size_t q = 0; q < to.ny; ++q) {
+            o[q] += mul(a, r[q]);
+          }
+        }
+      }
+    });
+
+    const cplx global = polar(z / lambda) * (medium.loss / z);
+    double* outRe = dst.re(ch);
+    double* outIm = dst.im(ch);
+    for(size_t p = 0; p < dst.size(); ++p) {
+      const cplx v = mul(out[to.cell(p)], global);
+      outRe[p] = v.real();
+      outIm[p] = v.imag();
+    }
+  }
+}
+
+}  // namespace fresnel
+}  // namespace phys
@@ -0,0 +1,45 @@
+#ifndef ENGINE_FRESNEL_HPP
+#define ENGINE_FRESNEL_HPP
+
+#include "field.hpp"
+#include "kernels.hpp"
+
+// Grid-to-grid propagation in the Fresnel approximation. Expanding the
+// path as l = z + ((x - u)^2 + (y - v)^2) / 2z turns the Huygens sum into
+// quadratic phases around a separable sum of exp(-i x u / (z lambda)),
+// with 1/l taken as 1/z. Source and destination may have any pitch and
+// window.
+//
+// The dropped path terms are of order r^4 / (8 z^3), r the largest lateral
+// offset between the grids; phaseError() reports the resulting error.
+
+namespace phys {
+namespace fresnel {
+
+// Both fields are grids in different planes.
+bool applicable(const Field& src, const Field& dst);
+
+// Same for a destination given only by its grid and plane.
+bool applicable(const Field& src, const GridLayout& to, double z);
+
+// Largest phase error in radians the approximation makes for this pair of
+// grids at the given wavelength.
+double phaseError(const Field& src, const Field& dst, double lambda);
+
+double phaseError(const Field& src, const GridLayout& to, double z, double lambda);
+
+// Chirp-z transform (Bluestein's algorithm) of the separable sum: any
+// output start and step at O(N^2 log N) for N x N grids, so a small
+// destination window can zoom into one diffraction order at full
+// resolution. Writes every channel of dst.
+void chirpz(const Field& src, Field& dst, const kernels::Medium& medium);
+
+// The same sum as two dense products, out = Ax * src * Ay^T, with
+// Ax[p][i] = exp(i (x_p - u_i)^2 / (2 z lambda)): O(N^3) for N x N grids
+// and no FFT rounding. Writes every channel of dst.
+void separable(const Field& src, Field& dst, const kernels::Medium& medium);
+
+}  // namespace fresnel
+}  // namespace phys
+
+#endif /* ENGINE_FRESNEL_HPP */
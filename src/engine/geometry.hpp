@@ -171,8 +171,10 @@ struct Vector {
         static_assert(dim == 2);
         T x = X();
         T y = Y();
-        m_coord[0] = x * traits<U>::cos(angle) - y * traits<U>::sin(angle); 
-        m_coord[1] = x * traits<U>::sin(angle) + y * traits<U>::cos(angle);
+        auto c = traits<U>::cos(angle);
+        auto s = traits<U>::sin(angle);
+        m_coord[0] = x * c - y * s;
+        m_coord[1] = x * s + y * c;
         return *this; 
     }
 };
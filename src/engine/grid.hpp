@@ -0,0 +1,47 @@
+#ifndef ENGINE_GRID_HPP
+#define ENGINE_GRID_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace phys {
+
+// Points of a field that sit on a regular grid in a plane of constant z:
+// cell (i, j) is at (x0 + i * dx, y0 + j * dy), i < nx, j < ny. Fast
+// propagators use it to turn the pairwise sum into a convolution.
+struct GridLayout {
+  double x0 = 0.;
+  double y0 = 0.;
+  double dx = 0.;
+  double dy = 0.;
+  size_t nx = 0;
+  size_t ny = 0;
+
+  // Cell i * ny + j of every field point, in field order. Empty when the
+  // field holds every cell in that order.
+  std::vector<uint32_t> cells{};
+
+  size_t
+  cell(size_t point) const {
+    return cells.empty() ? point : cells[point];
+  }
+
+  size_t
+  points() const {
+    return cells.empty() ? nx * ny : cells.size();
+  }
+
+  // Same pitch up to rounding, so one sampled kernel fits both grids.
+  bool
+  samePitch(const GridLayout& oth) const {
+    constexpr const double Tolerance = 1e-9;
+    return std::abs(dx - oth.dx) <= Tolerance * std::abs(dx) &&
+           std::abs(dy - oth.dy) <= Tolerance * std::abs(dy);
+  }
+};
+
+}  // namespace phys
+
+#endif /* ENGINE_GRID_HPP */
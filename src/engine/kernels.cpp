@@ -0,0 +1,557 @@
+#include "kernels.hpp"
+#include "simd.hpp"
+#include "trig.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace phys {
+namespace kernels {
+
+namespace {
+
+template <SinCos Tier>
+inline void 
+sincosOf(const trig::Table& tbl, double phase, double& s, double& c) {
+  if constexpr (Tier == SinCos::Exact) {
+    trig::exact(phase, s, c);
+  } else if constexpr (Tier == SinCos::Poly) {
+    trig::poly(phase, s, c);
+  } else {
+    trig::lookup(tbl, phase, s, c);
+  }
+}
+
+// Phase policies: scale() turns a wavelength into what sincos() combines
+// with the distance of a pair.
+template <SinCos Tier>
+struct ScalarRadians {
+  static double scale(double lambda) {return lambda;}
+
+  static void sincos(const trig::Table& tbl, double l, double scale, double& s, double& c) {
+    sincosOf<Tier>(tbl, l / scale, s, c);
+  }
+};
+
+struct ScalarTurns {
+  static double scale(double lambda) {return 1. / (trig::TwoPi * lambda);}
+
+  static void sincos(const trig::Table& tbl, double l, double scale, double& s, double& c) {
+    trig::turns(tbl, trig::toTurns(l * scale), s, c);
+  }
+};
+
+template <class Phase, typename Real>
+void 
+scalarImpl(const BasicField<Real>& src, const Targets& dst, size_t begin, size_t end, const Medium& medium) {
+  const double* sx  = src.xs();
+  const double* sy  = src.ys();
+  const double* sz  = src.zs();
+  const size_t  n   = src.size();
+  const size_t  channels = medium.channels;
+  const trig::Table& tbl = trig::table();
+
+  std::array<const Real*, Field::MaxChannels> sre;
+  std::array<const Real*, Field::MaxChannels> sim;
+  std::array<double, Field::MaxChannels> scale;
+  for(size_t ch = 0; ch < channels; ++ch) {
+    sre[ch] = src.re(ch);
+    sim[ch] = src.im(ch);
+    scale[ch] = Phase::scale(medium.lambda[ch]);
+  }
+
+  // Same arithmetic as EWave::traveled, but on plain double streams.
+  std::array<double, Field::MaxChannels> re;
+  std::array<double, Field::MaxChannels> im;
+  for(size_t i = begin; i < end; ++i) {
+    re.fill(0.);
+    im.fill(0.);
+    for(size_t j = 0; j < n; ++j) {
+      double x = sx[j] - dst.x[i];
+      double y = sy[j] - dst.y[i];
+      double z = sz[j] - dst.z[i];
+      double l = std::sqrt(x * x + y * y + z * z);
+      double amp = medium.loss / l;
+
+      for(size_t ch = 0; ch < channels; ++ch) {
+        double s, c;
+        Phase::sincos(tbl, l, scale[ch], s, c);
+        double wre = sre[ch][j] * amp;
+        double wim = sim[ch][j] * amp;
+        re[ch] += wre * c - wim * s;
+        im[ch] += wre * s + wim * c;
+      }
+    }
+    for(size_t ch = 0; ch < channels; ++ch) {
+      dst.re[ch][i] = re[ch];
+      dst.im[ch][i] = im[ch];
+    }
+  }
+}
+
+}  // namespace
+
+void 
+scalar(const Field& src, const Targets& dst, size_t begin, size_t end, const Medium& medium, 
+       const PropagationConfig& config) {
+  if(config.phase == Phase::Turns) {
+    scalarImpl<ScalarTurns>(src, dst, begin, end, medium);
+    return;
+  }
+
+  switch(config.sincos) {
+    case SinCos::Poly:
+      scalarImpl<ScalarRadians<SinCos::Poly>>(src, dst, begin, end, medium);
+      break;
+    case SinCos::Table:
+      scalarImpl<ScalarRadians<SinCos::Table>>(src, dst, begin, end, medium);
+      break;
+    case SinCos::Exact:
+    default:
+      scalarImpl<ScalarRadians<SinCos::Exact>>(src, dst, begin, end, medium);
+      break;
+  }
+}
+
+void 
+scalar(const FieldF& src, const Targets& dst, size_t begin, size_t end, const Medium& medium, 
+       const PropagationConfig&) {
+  scalarImpl<ScalarTurns>(src, dst, begin, end, medium);
+}
+
+namespace {
+
+// sqrt, the division and sin/cos dominate a scalar pair, so the planes are
+// summed one after another by the plain kernel, on targets that start at
+// begin.
+void 
+scalarStack(const Field& src, const Stack& dst, size_t begin, size_t end, const Medium& medium, 
+            const PropagationConfig& config) {
+  const size_t channels = medium.channels;
+  std::vector<double> z(end - begin);
+  std::array<double*, Field::MaxChannels> re;
+  std::array<double*, Field::MaxChannels> im;
+  for(size_t k = 0; k < dst.planes; ++k) {
+    std::fill(z.begin(), z.end(), dst.z[k]);
+    for(size_t ch = 0; ch < channels; ++ch) {
+      re[ch] = dst.re[k * channels + ch] + begin;
+      im[ch] = dst.im[k * channels + ch] + begin;
+    }
+    const Targets plane{dst.x + begin, dst.y + begin, z.data(), re.data(), im.data()};
+    scalar(src, plane, 0, end - begin, medium, config);
+  }
+}
+
+}  // namespace
+
+#if PHYS_SIMD_WIDTH > 1
+
+namespace {
+
+struct Accumulator {
+  simd::vd re = simd::zero();
+  simd::vd im = simd::zero();
+};
+
+// Sources are streamed in tiles of about tileBytes, and every destination
+// of a block runs over a tile before the next one is loaded, so a tile
+// comes from beyond L2 once per block instead of once per point. Vector
+// accumulators persist between tiles: every lane still adds its sources in
+// order and the sums do not depend on the tiling.
+constexpr const size_t DestBlock = 64;
+
+// Sources per tile, a multiple of step; all of them when tileBytes is 0.
+size_t 
+tileSources(size_t n, size_t bytesPerSource, size_t tileBytes, size_t step) {
+  if(tileBytes == 0) {
+    return std::max<size_t>(n, 1);
+  }
+  return std::max(tileBytes / bytesPerSource / step * step, step);
+}
+
+template <SinCos Tier>
+inline void 
+sincosOf(const trig::Table& tbl, simd::vd phase, simd::vd& s, simd::vd& c) {
+  if constexpr (Tier == SinCos::Exact) {
+    simd::sincos(phase, s, c);
+  } else if constexpr (Tier == SinCos::Poly) {
+    simd::sincosPoly(phase, s, c);
+  } else {
+    simd::sincosTable(tbl, phase, s, c);
+  }
+}
+
+template <SinCos Tier>
+struct VectorRadians {
+  static double scale(double lambda) {return 1. / lambda;}
+
+  static void sincos(const trig::Table& tbl, simd::vd l, simd::vd scale, simd::vd& s, simd::vd& c) {
+    sincosOf<Tier>(tbl, simd::mul(l, scale), s, c);
+  }
+};
+
+struct VectorTurns {
+  static double scale(double lambda) {return 1. / (trig::TwoPi * lambda);}
+
+  static void sincos(const trig::Table& tbl, simd::vd l, simd::vd scale, simd::vd& s, simd::vd& c) {
+    simd::sincosTurns(tbl, simd::mul(l, scale), s, c);
+  }
+};
+
+// One vector of sources starting at j against one destination point. With
+// n < Width only the first n lanes contribute.
+template <class Phase>
+inline void 
+accumulate(Accumulator* acc, const Field& src, size_t j, simd::vd px, simd::vd py, simd::vd pz,
+           simd::vd loss, const simd::vd* scale, size_t channels, const trig::Table& tbl, 
+           size_t n = simd::Width) {
+  using namespace simd;
+  auto get = [&](const double* p) {return n < Width ? loadTail(p + j, n) : load(p + j);};
+
+  vd x = sub(get(src.xs()), px);
+  vd y = sub(get(src.ys()), py);
+  vd z = sub(get(src.zs()), pz);
+  vd l = sqrt(fmadd(x, x, fmadd(y, y, mul(z, z))));
+  vd amp = div(loss, l);
+  if(n < Width) {
+    amp = keepTail(amp, n);
+  }
+
+  for(size_t ch = 0; ch < channels; ++ch) {
+    vd s, c;
+    Phase::sincos(tbl, l, scale[ch], s, c);
+
+    vd wre = mul(get(src.re(ch)), amp);
+    vd wim = mul(get(src.im(ch)), amp);
+    acc[ch].re = fmadd(wre, c, fnmadd(wim, s, acc[ch].re));
+    acc[ch].im = fmadd(wre, s, fmadd(wim, c, acc[ch].im));
+  }
+}
+
+template <class Phase>
+void 
+simdImpl(const Field& src, const Targets& dst, size_t begin, size_t end, const Medium& medium, 
+         size_t tileBytes) {
+  using namespace simd;
+  const size_t n        = src.size();
+  const size_t channels = medium.channels;
+  const size_t tile     = tileSources(n, (3 + 2 * channels) * sizeof(double), tileBytes, Width);
+  const trig::Table& tbl = trig::table();
+
+  const vd loss = set1(medium.loss);
+  vd scale[Field::MaxChannels];
+  for(size_t ch = 0; ch < channels; ++ch) {
+    scale[ch] = set1(Phase::scale(medium.lambda[ch]));
+  }
+
+  std::vector<Accumulator> acc(DestBlock * channels);
+  for(size_t first = begin; first < end; first += DestBlock) {
+    const size_t last = std::min(end, first + DestBlock);
+    std::fill(acc.begin(), acc.end(), Accumulator{});
+
+    for(size_t from = 0; from < n; from += tile) {
+      const size_t to = std::min(n, from + tile);
+      for(size_t i = first; i < last; ++i) {
+        const vd px = set1(dst.x[i]);
+        const vd py = set1(dst.y[i]);
+        const vd pz = set1(dst.z[i]);
+
+        Accumulator* point = &acc[(i - first) * channels];
+        size_t j = from;
+        for(; j + Width <= to; j += Width) {
+          accumulate<Phase>(point, src, j, px, py, pz, loss, scale, channels, tbl);
+        }
+        if(j < to) {
+          accumulate<Phase>(point, src, j, px, py, pz, loss, scale, channels, tbl, to - j);
+        }
+      }
+    }
+
+    for(size_t i = first; i < last; ++i) {
+      const Accumulator* point = &acc[(i - first) * channels];
+      for(size_t ch = 0; ch < channels; ++ch) {
+        dst.re[ch][i] = hsum(point[ch].re);
+        dst.im[ch][i] = hsum(point[ch].im);
+      }
+    }
+  }
+}
+
+// Planes summed together: a vector of sources and its dx^2 + dy^2 are
+// loaded once for all of them.
+constexpr const size_t PlaneBlock = 8;
+
+template <class Phase>
+void 
+stackImpl(const Field& src, const Stack& dst, size_t begin, size_t end, const Medium& medium) {
+  using namespace simd;
+  const size_t n        = src.size();
+  const size_t channels = medium.channels;
+  const trig::Table& tbl = trig::table();
+
+  const vd loss = set1(medium.loss);
+  vd scale[Field::MaxChannels];
+  for(size_t ch = 0; ch < channels; ++ch) {
+    scale[ch] = set1(Phase::scale(medium.lambda[ch]));
+  }
+
+  std::vector<Accumulator> acc(PlaneBlock * channels);
+  for(size_t i = begin; i < end; ++i) {
+    const vd px = set1(dst.x[i]);
+    const vd py = set1(dst.y[i]);
+
+    for(size_t first = 0; first < dst.planes; first += PlaneBlock) {
+      const size_t count = std::min(PlaneBlock, dst.planes - first);
+      vd pz[PlaneBlock];
+      for(size_t k = 0; k < count; ++k) {
+        pz[k] = set1(dst.z[first + k]);
+      }
+      std::fill(acc.begin(), acc.end(), Accumulator{});
+
+      for(size_t j = 0; j < n; j += Width) {
+        const size_t left = std::min(Width, n - j);
+        auto get = [&](const double* p) {return left < Width ? loadTail(p + j, left) : load(p + j);};
+
+        const vd x = sub(get(src.xs()), px);
+        const vd y = sub(get(src.ys()), py);
+        const vd lateral = fmadd(x, x, mul(y, y));
+        const vd sz = get(src.zs());
+        for(size_t k = 0; k < count; ++k) {
+          const vd z = sub(sz, pz[k]);
+          const vd l = sqrt(fmadd(z, z, lateral));
+          vd amp = div(loss, l);
+          if(left < Width) {
+            amp = keepTail(amp, left);
+          }
+
+          Accumulator* plane = &acc[k * channels];
+          for(size_t ch = 0; ch < channels; ++ch) {
+            vd s, c;
+            Phase::sincos(tbl, l, scale[ch], s, c);
+            vd wre = mul(get(src.re(ch)), amp);
+            vd wim = mul(get(src.im(ch)), amp);
+            plane[ch].re = fmadd(wre, c, fnmadd(wim, s, plane[ch].re));
+            plane[ch].im = fmadd(wre, s, fmadd(wim, c, plane[ch].im));
+          }
+        }
+      }
+
+      for(size_t k = 0; k < count; ++k) {
+        for(size_t ch = 0; ch < channels; ++ch) {
+          const size_t out = (first + k) * channels + ch;
+          dst.re[out][i] = hsum(acc[k * channels + ch].re);
+          dst.im[out][i] = hsum(acc[k * channels + ch].im);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void 
+simd(const Field& src, const Targets& dst, size_t begin, size_t end, const Medium& medium, 
+     const PropagationConfig& config) {
+  if(config.phase == Phase::Turns) {
+    simdImpl<VectorTurns>(src, dst, begin, end, medium, config.tileBytes);
+    return;
+  }
+
+  switch(config.sincos) {
+    case SinCos::Poly:
+      simdImpl<VectorRadians<SinCos::Poly>>(src, dst, begin, end, medium, config.tileBytes);
+      break;
+    case SinCos::Table:
+      simdImpl<VectorRadians<SinCos::Table>>(src, dst, begin, end, medium, config.tileBytes);
+      break;
+    case SinCos::Exact:
+    default:
+      simdImpl<VectorRadians<SinCos::Exact>>(src, dst, begin, end, medium, config.tileBytes);
+      break;
+  }
+}
+
+namespace {
+
+// Float lanes: distances and the fractional turn are computed in double,
+// then sin/cos and the complex multiply-add run on WidthF floats at a time.
+// Float partial sums are moved into the double accumulators every
+// FlushEvery vectors, so their rounding error does not grow with the
+// source count.
+constexpr const size_t FlushEvery = 32;
+
+struct AccumulatorF {
+  simd::vf re = simd::zerof();
+  simd::vf im = simd::zerof();
+};
+
+using AccumulatorsF = std::array<AccumulatorF, Field::MaxChannels>;
+
+inline simd::vd 
+fraction(simd::vd t) {
+  return simd::sub(t, simd::floor(t));
+}
+
+inline void 
+accumulateMixed(AccumulatorsF& acc, const FieldF& src, size_t j, simd::vd px, simd::vd py, 
+                simd::vd pz, simd::vf loss, const simd::vd* scale, size_t channels, 
+                size_t n = simd::WidthF) {
+  using namespace simd;
+  const bool   tail = n < WidthF;
+  const size_t nLo  = std::min(n, Width);
+  const size_t nHi  = n - nLo;
+  auto getLo = [&](const double* p) {return tail ? loadTail(p + j, nLo) : load(p + j);};
+  auto getHi = [&](const double* p) {return tail ? loadTail(p + j + Width, nHi) : load(p + j + Width);};
+  auto getF  = [&](const float* p)  {return tail ? loadTail(p + j, n) : load(p + j);};
+
+  auto length = [&](auto get) {
+    vd x = sub(get(src.xs()), px);
+    vd y = sub(get(src.ys()), py);
+    vd z = sub(get(src.zs()), pz);
+    return sqrt(fmadd(x, x, fmadd(y, y, mul(z, z))));
+  };
+  vd lLo = length(getLo);
+  vd lHi = length(getHi);
+
+  vf amp = div(loss, toFloat(lLo, lHi));
+  if(tail) {
+    amp = keepTail(amp, n);
+  }
+
+  for(size_t ch = 0; ch < channels; ++ch) {
+    vf s, c;
+    sincosTurnFraction(toFloat(fraction(mul(lLo, scale[ch])), fraction(mul(lHi, scale[ch]))), s, c);
+
+    vf wre = mul(getF(src.re(ch)), amp);
+    vf wim = mul(getF(src.im(ch)), amp);
+    acc[ch].re = fmadd(wre, c, fnmadd(wim, s, acc[ch].re));
+    acc[ch].im = fmadd(wre, s, fmadd(wim, c, acc[ch].im));
+  }
+}
+
+void 
+flush(AccumulatorsF& accF, Accumulator* acc, size_t channels) {
+  using namespace simd;
+  for(size_t ch = 0; ch < channels; ++ch) {
+    acc[ch].re = add(acc[ch].re, add(lowHalf(accF[ch].re), highHalf(accF[ch].re)));
+    acc[ch].im = add(acc[ch].im, add(lowHalf(accF[ch].im), highHalf(accF[ch].im)));
+    accF[ch] = AccumulatorF{};
+  }
+}
+
+}  // namespace
+
+void 
+simd(const FieldF& src, const Targets& dst, size_t begin, size_t end, const Medium& medium, 
+     const PropagationConfig& config) {
+  using namespace simd;
+  const size_t n        = src.size();
+  const size_t channels = medium.channels;
+  // Whole flush periods per tile, so partial sums are flushed at the same
+  // sources as without tiling.
+  const size_t tile     = tileSources(n, 3 * sizeof(double) + 2 * channels * sizeof(float), 
+                                      config.tileBytes, WidthF * FlushEvery);
+
+  const vf loss = set1f(static_cast<float>(medium.loss));
+  vd scale[Field::MaxChannels];
+  for(size_t ch = 0; ch < channels; ++ch) {
+    scale[ch] = set1(1. / (trig::TwoPi * medium.lambda[ch]));
+  }
+
+  std::vector<Accumulator> acc(DestBlock * channels);
+  AccumulatorsF accF;
+  for(size_t first = begin; first < end; first += DestBlock) {
+    const size_t last = std::min(end, first + DestBlock);
+    std::fill(acc.begin(), acc.end(), Accumulator{});
+
+    for(size_t from = 0; from < n; from += tile) {
+      const size_t to = std::min(n, from + tile);
+      for(size_t i = first; i < last; ++i) {
+        const vd px = set1(dst.x[i]);
+        const vd py = set1(dst.y[i]);
+        const vd pz = set1(dst.z[i]);
+
+        Accumulator* point = &acc[(i - first) * channels];
+        std::fill_n(accF.begin(), channels, AccumulatorF{});
+        size_t j = from;
+        size_t pending = 0;
+        for(; j + WidthF <= to; j += WidthF) {
+          accumulateMixed(accF, src, j, px, py, pz, loss, scale, channels);
+          if(++pending == FlushEvery) {
+            flush(accF, point, channels);
+            pending = 0;
+          }
+        }
+        if(j < to) {
+          accumulateMixed(accF, src, j, px, py, pz, loss, scale, channels, to - j);
+        }
+        flush(accF, point, channels);
+      }
+    }
+
+    for(size_t i = first; i < last; ++i) {
+      const Accumulator* point = &acc[(i - first) * channels];
+      for(size_t ch = 0; ch < channels; ++ch) {
+        dst.re[ch][i] = hsum(point[ch].re);
+        dst.im[ch][i] = hsum(point[ch].im);
+      }
+    }
+  }
+}
+
+void 
+stack(const Field& src, const Stack& dst, size_t begin, size_t end, const Medium& medium, 
+      const PropagationConfig& config) {
+  if(config.kernel != Kernel::Simd) {
+    scalarStack(src, dst, begin, end, medium, config);
+    return;
+  }
+  if(config.phase == Phase::Turns) {
+    stackImpl<VectorTurns>(src, dst, begin, end, medium);
+    return;
+  }
+
+  switch(config.sincos) {
+    case SinCos::Poly:
+      stackImpl<VectorRadians<SinCos::Poly>>(src, dst, begin, end, medium);
+      break;
+    case SinCos::Table:
+      stackImpl<VectorRadians<SinCos::Table>>(src, dst, begin, end, medium);
+      break;
+    case SinCos::Exact:
+    default:
+      stackImpl<VectorRadians<SinCos::Exact>>(src, dst, begin, end, medium);
+      break;
+  }
+}
+
+#else
+
+void 
+simd(const Field& src, const Targets& dst, size_t begin, size_t end, const Medium& medium, 
+     const PropagationConfig& config) {
+  scalar(src, dst, begin, end, medium, config);
+}
+
+void 
+simd(const FieldF& src, const Targets& dst, size_t begin, size_t end, const Medium& medium, 
+     const PropagationConfig& config) {
+  scalar(src, dst, begin, end, medium, config);
+}
+
+void 
+stack(const Field& src, const Stack& dst, size_t begin, size_t end, const Medium& medium, 
+      const PropagationConfig& config) {
+  scalarStack(src, dst, begin, end, medium, config);
+}
+
+#endif
+
+size_t 
+simdWidth() {
+  return PHYS_SIMD_WIDTH;
+}
+
+}  // namespace kernels
+}  // namespace phys
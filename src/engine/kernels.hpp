@@ -0,0 +1,71 @@
+#ifndef ENGINE_KERNELS_HPP
+#define ENGINE_KERNELS_HPP
+
+#include "field.hpp"
+#include "propagation.hpp"
+#include <cstddef>
+
+namespace phys {
+namespace kernels {
+
+// Plain-number view of the WavyEnvironments of every channel; they only
+// differ in wavelength.
+struct Medium {
+  double loss;
+  const double* lambda;
+  size_t channels;
+};
+
+// Destination streams; the kernels only write re and im of every channel.
+struct Targets {
+  const double* x;
+  const double* y;
+  const double* z;
+  double* const* re;
+  double* const* im;
+};
+
+// Sums every source of src into destination points [begin, end). Distance
+// and 1/r of a pair are computed once and shared by all channels.
+// The phase representation and sin/cos tier come from config.
+void scalar(const Field& src, const Targets& dst, size_t begin, size_t end, const Medium& medium,
+            const PropagationConfig& config = {});
+
+void simd(const Field& src, const Targets& dst, size_t begin, size_t end, const Medium& medium,
+          const PropagationConfig& config = {});
+
+// Mixed precision: float amplitudes and float sin/cos of the phase, kept
+// as a turn fraction; positions, distances and the final sums stay double.
+// The phase is always in turns, config.phase and config.sincos are ignored.
+void scalar(const FieldF& src, const Targets& dst, size_t begin, size_t end, const Medium& medium,
+            const PropagationConfig& config = {});
+
+void simd(const FieldF& src, const Targets& dst, size_t begin, size_t end, const Medium& medium,
+          const PropagationConfig& config = {});
+
+// Lateral destination points repeated on several planes z. Stream
+// plane * channels + channel of re and im belongs to that plane and channel.
+struct Stack {
+  const double* x;
+  const double* y;
+  const double* z;
+  size_t planes;
+  double* const* re;
+  double* const* im;
+};
+
+// Sums every source of src into lateral points [begin, end) on every plane
+// of dst. Only z differs between planes, so the SIMD loop computes
+// dx^2 + dy^2 of a pair once and loads the sources once per block of
+// planes; the scalar one sums the planes one by one. Amplitudes stay
+// double.
+void stack(const Field& src, const Stack& dst, size_t begin, size_t end, const Medium& medium,
+           const PropagationConfig& config = {});
+
+// Sources handled per instruction by simd(), 1 if it falls back to scalar().
+size_t simdWidth();
+
+}  // namespace kernels
+}  // namespace phys
+
+#endif /* ENGINE_KERNELS_HPP */
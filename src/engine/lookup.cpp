@@ -0,0 +1,261 @@
+#include "lookup.hpp"
+#include "parallel.hpp"
+#include "raw.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <mutex>
+
+namespace phys {
+namespace lookup {
+
+namespace {
+
+constexpr const size_t MinPairsPerTask = 1 << 16;
+
+// Destination points summed together; they share every load of the
+// sources and keep enough independent accumulators to hide FMA latency.
+// Two accumulators each, so AVX2 (16 registers) stops at 4.
+#if PHYS_SIMD_WIDTH >= 8
+constexpr const size_t Block = 8;
+#else
+constexpr const size_t Block = 4;
+#endif
+
+// Tables kept by table(), most recent last. A 512 x 512 hop takes 16 MiB
+// per channel.
+constexpr const size_t CacheBytes = size_t{256} << 20;
+
+struct Key {
+  double dx;
+  double dy;
+  double ox;
+  double oy;
+  double dz;
+  double lambda;
+  double loss;
+  size_t fromNx;
+  size_t fromNy;
+  size_t toNx;
+  size_t toNy;
+
+  bool 
+  operator==(const Key& oth) const {
+    return raw::same(dx, oth.dx) && raw::same(dy, oth.dy) && raw::same(ox, oth.ox) && raw::same(oy, oth.oy) &&
+           raw::same(dz, oth.dz) && raw::same(lambda, oth.lambda) && raw::same(loss, oth.loss) && fromNx == oth.fromNx &&
+           fromNy == oth.fromNy && toNx == oth.toNx && toNy == oth.toNy;
+  }
+};
+
+struct Cache {
+  std::mutex mutex{};
+  std::vector<std::pair<Key, std::shared_ptr<const KernelTable>>> tables{};
+};
+
+Cache& 
+cache() {
+  static Cache instance;
+  return instance;
+}
+
+// Sources on one grid row with consecutive cells: `length` field points
+// from `point` on, at table offset `offset` from the entry of cell (0, 0).
+struct Run {
+  size_t point;
+  size_t offset;
+  size_t length;
+};
+
+std::vector<Run> 
+runs(const GridLayout& from, size_t cols) {
+  std::vector<Run> out;
+  for(size_t p = 0; p < from.points(); ++p) {
+    const size_t cell = from.cell(p);
+    const size_t offset = (cell / from.ny) * cols + cell % from.ny;
+    if(!out.empty() && cell == from.cell(p - 1) + 1 && cell % from.ny != 0) {
+      ++out.back().length;
+    } else {
+      out.push_back({p, offset, 1});
+    }
+  }
+  return out;
+}
+
+// Sums every run into count destination points with table entries of
+// cell (0, 0) at origins[0..count).
+void 
+sumBlock(const KernelTable& kernel, const std::vector<Run>& sources, const double* re,
+         const double* im, const size_t* origins, size_t count, double* outRe, double* outIm) {
+  const double* tre = kernel.re();
+  const double* tim = kernel.im();
+
+#if PHYS_SIMD_WIDTH > 1
+  using namespace simd;
+  vd accRe[Block];
+  vd accIm[Block];
+  for(size_t b = 0; b < Block; ++b) {
+    accRe[b] = zero();
+    accIm[b] = zero();
+  }
+  for(const Run& run : sources) {
+    const double* are = re + run.point;
+    const double* aim = im + run.point;
+    for(size_t j = 0; j < run.length; j += Width) {
+      const size_t left = run.length - j;
+      const vd sre = left >= Width ? load(are + j) : loadTail(are + j, left);
+      const vd sim = left >= Width ? load(aim + j) : loadTail(aim + j, left);
+      for(size_t b = 0; b < count; ++b) {
+        const size_t at = origins[b] + run.offset + j;
+        const vd kre = left >= Width ? load(tre + at) : loadTail(tre + at, left);
+        const vd kim = left >= Width ? load(tim + at) : loadTail(tim + at, left);
+        accRe[b] = fnmadd(sim, kim, fmadd(sre, kre, accRe[b]));
+        accIm[b] = fmadd(sim, kre, fmadd(sre, kim, accIm[b]));
+      }
+    }
+  }
+  for(size_t b = 0; b < count; ++b) {
+    outRe[b] = hsum(accRe[b]);
+    outIm[b] = hsum(accIm[b]);
+  }
+#else
+  for(size_t b = 0; b < count; ++b) {
+    double sumRe = 0.;
+    double sumIm = 0.;
+    for(const Run& run : sources) {
+      const double* kre = tre + origins[b] + run.offset;
+      const double* kim = tim + origins[b] + run.offset;
+      for(size_t j = 0; j < run.length; ++j) {
+        const double sre = re[run.point + j];
+        const double sim = im[run.point + j];
+        sumRe += sre * kre[j] - sim * kim[j];
+        sumIm += sre * kim[j] + sim * kre[j];
+      }
+    }
+    outRe[b] = sumRe;
+    outIm[b] = sumIm;
+  }
+#endif
+}
+
+}  // namespace
+
+//====================================================================================/
+//===================================< Table >========================================/
+//====================================================================================/
+
+KernelTable::KernelTable(const GridLayout& from, const GridLayout& to, double dz, double lambda,
+                         double loss)
+    : m_rows(from.nx + to.nx - 1), m_cols(from.ny + to.ny - 1),
+      m_fromRows(from.nx), m_fromCols(from.ny),
+      m_re(m_rows * m_cols), m_im(m_rows * m_cols) {
+  // Source minus destination is -o + m * d for m = i - k.
+  const double ox = to.x0 - from.x0;
+  const double oy = to.y0 - from.y0;
+  const double dz2 = dz * dz;
+  const ptrdiff_t mFirst = 1 - static_cast<ptrdiff_t>(to.nx);
+  const ptrdiff_t nFirst = 1 - static_cast<ptrdiff_t>(to.ny);
+
+  // Same pair term as kernels::scalar.
+  parallel::forRanges(m_rows, 16, [&](size_t begin, size_t end) {
+    for(size_t r = begin; r < end; ++r) {
+      const double x = static_cast<double>(mFirst + static_cast<ptrdiff_t>(r)) * from.dx - ox;
+      for(size_t c = 0; c < m_cols; ++c) {
+        const double y = static_cast<double>(nFirst + static_cast<ptrdiff_t>(c)) * from.dy - oy;
+        const double l = std::sqrt(x * x + y * y + dz2);
+        const double amp = loss / l;
+        m_re[r * m_cols + c] = amp * std::cos(l / lambda);
+        m_im[r * m_cols + c] = amp * std::sin(l / lambda);
+      }
+    }
+  });
+}
+
+std::shared_ptr<const KernelTable> 
+table(const Field& src, const Field& dst, double lambda, double loss) {
+  const GridLayout& from = *src.grid();
+  const GridLayout& to   = *dst.grid();
+  const Key key{from.dx, from.dy, to.x0 - from.x0, to.y0 - from.y0, src.zs()[0] - dst.zs()[0],
+                lambda, loss, from.nx, from.ny, to.nx, to.ny};
+
+  Cache& shared = cache();
+  {
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for(auto it = shared.tables.begin(); it != shared.tables.end(); ++it) {
+      if(it->first == key) {
+        auto found = it->second;
+        shared.tables.erase(it);
+        shared.tables.emplace_back(key, found);
+        return found;
+      }
+    }
+  }
+
+  // Built unlocked: it runs on the pool and can take a while.
+  auto made = std::make_shared<const KernelTable>(from, to, key.dz, lambda, loss);
+  if(parallel::cancelled()) {
+    // Some rows were skipped, the caller throws its result away anyway.
+    return made;
+  }
+  const size_t bytes = 2 * sizeof(double) * made->rows() * made->cols();
+
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  size_t total = bytes;
+  for(const auto& entry : shared.tables) {
+    total += 2 * sizeof(double) * entry.second->rows() * entry.second->cols();
+  }
+  auto it = shared.tables.begin();
+  while(total > CacheBytes && it != shared.tables.end()) {
+    total -= 2 * sizeof(double) * it->second->rows() * it->second->cols();
+    it = shared.tables.erase(it);
+  }
+  if(bytes <= CacheBytes) {
+    shared.tables.emplace_back(key, made);
+  }
+  return made;
+}
+
+//====================================================================================/
+//=================================< Propagation >====================================/
+//====================================================================================/
+
+bool 
+applicable(const Field& src, const Field& dst) {
+  return dst.grid() != nullptr && applicable(src, *dst.grid(), dst.zs()[0]);
+}
+
+bool 
+applicable(const Field& src, const GridLayout& to, double z) {
+  const GridLayout* from = src.grid();
+  return from != nullptr && from->samePitch(to) && !raw::same(src.zs()[0], z);
+}
+
+void 
+propagate(const Field& src, Field& dst, const kernels::Medium& medium) {
+  const GridLayout& to = *dst.grid();
+
+  for(size_t ch = 0; ch < medium.channels; ++ch) {
+    const std::shared_ptr<const KernelTable> kernel = table(src, dst, medium.lambda[ch], medium.loss);
+    const std::vector<Run> sources = runs(*src.grid(), kernel->cols());
+    const double* re = src.re(ch);
+    const double* im = src.im(ch);
+    double* outRe = dst.re(ch);
+    double* outIm = dst.im(ch);
+
+    size_t grain = MinPairsPerTask / std::max<size_t>(src.size(), 1);
+    parallel::forRanges(dst.size(), grain, [&](size_t begin, size_t end) {
+      size_t origins[Block];
+      for(size_t p = begin; p < end; p += Block) {
+        const size_t count = std::min(Block, end - p);
+        for(size_t b = 0; b < count; ++b) {
+          const size_t cell = to.cell(p + b);
+          origins[b] = kernel->origin(cell / to.ny, cell % to.ny);
+        }
+        sumBlock(*kernel, sources, re, im, origins, count, outRe + p, outIm + p);
+      }
+    });
+  }
+}
+
+}  // namespace lookup
+}  // namespace phys
@@ -0,0 +1,62 @@
+#ifndef ENGINE_LOOKUP_HPP
+#define ENGINE_LOOKUP_HPP
+
+#include "field.hpp"
+#include "kernels.hpp"
+#include <memory>
+
+// Grid-to-grid direct sum by table lookup. Between grids of the same pitch
+// in parallel planes a pair term depends only on the difference of the
+// cells, so it is sampled once per offset, (nx + nx' - 1)(ny + ny' - 1)
+// entries, and the sum reads it back instead of computing sqrt and sin/cos.
+// Nothing is approximated: the result is the direct sum up to summation
+// order. The same table feeds the FFT convolution.
+
+namespace phys {
+namespace lookup {
+
+// Term loss / l * exp(i l / lambda) of every source cell (i, j) and
+// destination cell (k, l), at row i - k + to.nx - 1 and column
+// j - l + to.ny - 1; a row of sources is contiguous in the table.
+class KernelTable {
+ public:
+  KernelTable(const GridLayout& from, const GridLayout& to, double dz, double lambda, double loss);
+
+  size_t rows() const {return m_rows;}
+  size_t cols() const {return m_cols;}
+
+  // Entry of source cell (0, 0) for destination cell (k, l).
+  size_t 
+  origin(size_t k, size_t l) const {
+    return (m_rows - m_fromRows - k) * m_cols + (m_cols - m_fromCols - l);
+  }
+
+  const double* re() const {return m_re.data();}
+  const double* im() const {return m_im.data();}
+
+ private:
+  size_t m_rows;
+  size_t m_cols;
+  size_t m_fromRows;
+  size_t m_fromCols;
+  AlignedVector<double> m_re;
+  AlignedVector<double> m_im;
+};
+
+// Table of a hop, shared with earlier calls of the same geometry and
+// wavelength; the most recent ones are kept up to a fixed memory budget.
+std::shared_ptr<const KernelTable> table(const Field& src, const Field& dst, double lambda, double loss);
+
+// Both fields are grids of the same pitch in different planes.
+bool applicable(const Field& src, const Field& dst);
+
+// Same for a destination given only by its grid and plane.
+bool applicable(const Field& src, const GridLayout& to, double z);
+
+// Writes every channel of dst.
+void propagate(const Field& src, Field& dst, const kernels::Medium& medium);
+
+}  // namespace lookup
+}  // namespace phys
+
+#endif /* ENGINE_LOOKUP_HPP */
@@ -0,0 +1,101 @@
+#include "parallel.hpp"
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace phys {
+namespace parallel {
+
+namespace {
+
+// Each worker gets a few chunks so that uneven rows still balance out.
+constexpr const size_t ChunksPerThread = 4;
+
+// More and shorter chunks when the work can be cancelled, so it stops
+// soon after the flag is set.
+constexpr const size_t CancellableChunksPerThread = 32;
+
+size_t gThreads = 0;
+
+thread_local const std::atomic<bool>* tCancel = nullptr;
+
+QThreadPool& pool() {
+  static QThreadPool instance;
+  return instance;
+}
+
+}  // namespace
+
+void 
+setThreadCount(size_t threads) {
+  gThreads = threads;
+  if(threads != 0) {
+    pool().setMaxThreadCount(static_cast<int>(threads));
+  } else {
+    pool().setMaxThreadCount(QThread::idealThreadCount());
+  }
+}
+
+size_t 
+threadCount() {
+  if(gThreads != 0) {
+    return gThreads;
+  }
+  return static_cast<size_t>(std::max(1, QThread::idealThreadCount()));
+}
+
+void 
+forRanges(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body) {
+  if(n == 0) {
+    return;
+  }
+
+  // Pool threads check the flag of the caller, not their own.
+  const std::atomic<bool>* cancel = tCancel;
+
+  grain = std::max<size_t>(grain, 1);
+  size_t threads   = threadCount();
+  size_t perThread = cancel != nullptr ? CancellableChunksPerThread : ChunksPerThread;
+  size_t chunks    = std::min(threads * perThread, (n + grain - 1) / grain);
+  if(cancel == nullptr && (threads == 1 || chunks <= 1)) {
+    body(0, n);
+    return;
+  }
+
+  std::vector<std::pair<size_t, size_t>> ranges;
+  ranges.reserve(chunks);
+  for(size_t i = 0; i < chunks; ++i) {
+    ranges.emplace_back(n * i / chunks, n * (i + 1) / chunks);
+  }
+
+  auto run = [&body, cancel](const std::pair<size_t, size_t>& range) {
+    if(cancel == nullptr || !cancel->load(std::memory_order_relaxed)) {
+      body(range.first, range.second);
+    }
+  };
+  if(threads == 1 || chunks <= 1) {
+    std::for_each(ranges.begin(), ranges.end(), run);
+    return;
+  }
+
+  QtConcurrent::blockingMap(&pool(), ranges, run);
+}
+
+Cancellation::Cancellation(const std::atomic<bool>& flag) : m_previous(tCancel) {
+  tCancel = &flag;
+}
+
+Cancellation::~Cancellation() {
+  tCancel = m_previous;
+}
+
+bool 
+cancelled() {
+  return tCancel != nullptr && tCancel->load(std::memory_order_relaxed);
+}
+
+}  // namespace parallel
+}  // namespace phys
@@ -0,0 +1,46 @@
+#ifndef ENGINE_PARALLEL_HPP
+#define ENGINE_PARALLEL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+namespace phys {
+namespace parallel {
+
+// 0 means "use every core the machine has".
+void setThreadCount(size_t threads);
+
+size_t threadCount();
+
+// Below this many source-destination pairs a task is not worth scheduling.
+constexpr const size_t MinPairsPerTask = 1 << 14;
+
+// Splits [0, n) into contiguous chunks of at least `grain` items and calls
+// body(begin, end) for each of them on the engine thread pool. Blocks until
+// every chunk is done. With one thread the body is called inline, in order.
+void forRanges(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+// Lets another thread stop the computations of this one. While it lives,
+// forRanges called from the thread that made it skips the chunks that have
+// not started once flag is set, so a hop stops within a chunk. Whatever a
+// cancelled computation wrote is garbage.
+class Cancellation {
+ public:
+  explicit Cancellation(const std::atomic<bool>& flag);
+  ~Cancellation();
+
+  Cancellation(const Cancellation&) = delete;
+  Cancellation& operator=(const Cancellation&) = delete;
+
+ private:
+  const std::atomic<bool>* m_previous;
+};
+
+// The flag of the calling thread is set.
+bool cancelled();
+
+}  // namespace parallel
+}  // namespace phys
+
+#endif /* ENGINE_PARALLEL_HPP */
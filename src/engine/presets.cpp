@@ -0,0 +1,138 @@
+#include "presets.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace phys {
+namespace presets {
+
+namespace {
+
+constexpr const Length Mid      = BoxSize / 2.__;
+constexpr const Length LightZ   = -2_m;
+constexpr const Length BarrierZ = -1_m;
+constexpr const Position LightPos{Mid, Mid, LightZ};
+constexpr const Position BarrierCorner{BoxSize, BoxSize, BarrierZ};
+constexpr const Position LensCorner{BoxSize, BoxSize, BarrierZ + 0.1_m};
+constexpr const RefractiveIndex Glass = 1.43__;
+
+// What the lens presets add to z at dx, dy from the middle of the box: a
+// sphere of radius mid, 0 in the corners of the box outside it.
+double
+bulge(double mid, double dx, double dy) {
+  return std::sqrt(std::max(0., mid * mid - dx * dx - dy * dy));
+}
+
+// The light and the screen all presets share.
+Scene
+box() {
+  Scene scene;
+  auto lights = std::make_unique<PointLights>();
+  lights->addSource(std::make_pair(EWave{EFieldVal{1.}}, LightPos));
+  scene.lights = lights.get();
+  scene.surfaces.push_back(std::move(lights));
+  scene.screenTo = Position{BoxSize, BoxSize, 0_m};
+  return scene;
+}
+
+template <typename Shape>
+Scene
+glass(Shape shape) {
+  Scene scene = box();
+  scene.interactive = false;
+
+  auto front = std::make_unique<ContigSurface>(BarrierCorner);
+  front->setResolution(30);
+  scene.surfaces.push_back(std::move(front));
+
+  auto back = std::make_unique<ShapedSurface<Shape>>(LensCorner, std::move(shape));
+  back->setResolution(30);
+  scene.surfaces.push_back(std::move(back));
+
+  scene.ns = {1.__, Glass};
+  return scene;
+}
+
+}  // namespace
+
+Scene
+young() {
+  Scene scene = box();
+  auto barrier = std::make_unique<PointsBarrier>();
+  barrier->addHole(Position{Mid, Mid - 1e-3_m, BarrierZ});
+  barrier->addHole(Position{Mid, Mid + 1e-3_m, BarrierZ});
+  scene.surfaces.push_back(std::move(barrier));
+  return scene;
+}
+
+Scene
+diffraction() {
+  Scene scene = box();
+  scene.interactive = false;
+
+  // Open where the path from the light to the middle of the screen is in
+  // the first half of a red wave.
+  const Length redLen = consts::c / consts::red;
+  auto transparent = [=](Position pos) -> bool {
+    auto lens = ((LightPos - pos).Len() + (pos - Position{Mid, Mid}).Len()) / redLen;
+    double val = lens->getVal();
+    return (val - static_cast<long>(val)) <= 0.5;
+  };
+
+  auto barrier = std::make_unique<ContigSurface>(BarrierCorner, transparent);
+  barrier->setResolution(10);
+  scene.surfaces.push_back(std::move(barrier));
+  return scene;
+}
+
+Scene
+lens() {
+  const double mid = raw::value(Mid);
+  return glass([mid](ContigSurface::Row& row) {
+    for(size_t k = 0; k < row.n; ++k) {
+      const double dx = row.x[k] - mid;
+      const double dy = row.y[k] - mid;
+      row.z[k] += bulge(mid, dx, dy);
+    }
+  });
+}
+
+Scene
+fresnel() {
+  const double mid  = raw::value(Mid);
+  const double step = raw::value(consts::c / consts::red * Glass);
+  return glass([mid, step](ContigSurface::Row& row) {
+    for(size_t k = 0; k < row.n; ++k) {
+      const double dx = row.x[k] - mid;
+      const double dy = row.y[k] - mid;
+      double l = bulge(mid, dx, dy);
+      l -= std::floor(l / step) * step;
+      row.z[k] += l;
+    }
+  });
+}
+
+const std::vector<std::string>&
+names() {
+  static const std::vector<std::string> Names{"young", "diffraction", "lens", "fresnel"};
+  return Names;
+}
+
+std::optional<Scene>
+preset(const std::string& name) {
+  if(name == "young") {
+    return young();
+  }
+  if(name == "diffraction") {
+    return diffraction();
+  }
+  if(name == "lens") {
+    return lens();
+  }
+  if(name == "fresnel") {
+    return fresnel();
+  }
+  return std::nullopt;
+}
+
+}  // namespace presets
+}  // namespace phys
@@ -0,0 +1,39 @@
+#ifndef ENGINE_PRESETS_HPP
+#define ENGINE_PRESETS_HPP
+
+#include "scene.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+
+// The built-in scenes: one point light two metres in front of the screen,
+// at the middle of a square box, and different barriers one metre in
+// front of it.
+
+namespace phys {
+namespace presets {
+
+constexpr const Length BoxSize = 1e-2_m;
+
+// Two holes 2 mm apart.
+Scene young();
+
+// A zone plate for red light, sampled by a coarse mask.
+Scene diffraction();
+
+// Two glass surfaces 10 cm apart, the second one bent into a lens.
+Scene lens();
+
+// Same lens with its thickness folded modulo one wavelength in the glass.
+Scene fresnel();
+
+// The names preset() knows, in the order above.
+const std::vector<std::string>& names();
+
+// Empty for an unknown name.
+std::optional<Scene> preset(const std::string& name);
+
+}  // namespace presets
+}  // namespace phys
+
+#endif /* ENGINE_PRESETS_HPP */
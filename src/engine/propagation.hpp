@@ -0,0 +1,75 @@
+#ifndef ENGINE_PROPAGATION_HPP
+#define ENGINE_PROPAGATION_HPP
+
+#include <cstddef>
+
+namespace phys {
+
+// Which inner loop sums sources into a destination point.
+enum class Kernel {
+  Scalar, // libm sin/cos per pair, the reference
+  Simd,   // AVX2/AVX-512 lanes over sources, falls back to Scalar without them
+};
+
+// Accuracy of the sin/cos evaluated for the phase of every pair.
+enum class SinCos {
+  Exact, // libm (the SIMD kernel uses polynomials agreeing with it to ~1e-15)
+  Poly,  // short polynomials, error below 1e-7
+  Table, // nearest entry of a 4096-step table, error ~1e-3; for previews
+};
+
+// How the phase of a pair is represented before sin/cos.
+enum class Phase {
+  Radians, // l / lambda in double, reduced at the SinCos tier
+  Turns,   // path modulo the wavelength as a 32-bit fraction of a turn;
+           // sin/cos come from a table plus a short correction, so the
+           // SinCos tier is not used
+};
+
+// Storage type of the source amplitudes streamed through the kernel.
+enum class Precision {
+  Double, // double amplitudes, the phase as chosen by Phase
+  Mixed,  // float amplitudes and float sin/cos, twice the lanes per vector;
+          // distances and sums stay double and the phase is kept in turns.
+          // Relative error ~1e-6 of the field
+};
+
+// Algorithm summing the sources of one hop. Fast methods apply only to
+// some geometries, Fresnel ones only within fresnelTolerance; every other
+// hop falls back to Direct.
+enum class Method {
+  Direct, // every pair through Kernel
+  Fft,    // FFT convolution between grids of equal pitch in parallel planes
+  Lookup, // direct sum over a table of the pair terms, same grids as Fft
+  ChirpZ,   // Fresnel approximation by chirp-z between any grids in
+            // parallel planes, for a screen window and pitch unrelated to
+            // the aperture
+  Paraxial, // Fresnel approximation as two dense matrix products, O(N^3)
+  Tree,     // cluster trees with far pairs summed through a truncated
+            // series, for large unstructured sources; error bounded by
+            // treeTolerance
+};
+
+// How a Chamber propagates light between its surfaces.
+struct PropagationConfig {
+  Kernel kernel = Kernel::Scalar;
+  SinCos sincos = SinCos::Exact;
+  Phase  phase  = Phase::Radians;
+  Precision precision = Precision::Double;
+  Method method = Method::Direct;
+  // Largest phase error (radians) a Fresnel method may make on a hop;
+  // beyond it the hop is summed directly.
+  double fresnelTolerance = 0.1;
+  // Largest phase (radians) or relative amplitude error of a far pair in
+  // Method::Tree.
+  double treeTolerance = 1e-3;
+  // Sources the SIMD kernels keep in cache while a block of destinations
+  // runs over them, sized for L2; 0 streams every source per destination.
+  size_t tileBytes = size_t{1} << 18;
+
+  bool operator==(const PropagationConfig&) const = default;
+};
+
+}  // namespace phys
+
+#endif /* ENGINE_PROPAGATION_HPP */
@@ -0,0 +1,130 @@
+#ifndef ENGINE_RAW_HPP
+#define ENGINE_RAW_HPP
+
+#include "field.hpp"
+#include "units.hpp"
+#include "wave.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+// Unit-free layer for hot loops. Unit<> and unreal_t stay at the API
+// boundary; everything that touches every point of a field works on the
+// plain double streams of a Field and on the structs below. Conversions
+// happen once per call, in the functions of this header, which are the
+// only places allowed to strip a unit.
+
+namespace phys {
+namespace raw {
+
+// The wrappers must add nothing to a double, otherwise the views below and
+// the kernels reading Field streams would not be free.
+static_assert(sizeof(unreal_t) == sizeof(double));
+static_assert(std::is_trivially_copyable_v<unreal_t>);
+static_assert(sizeof(LengthVal) == sizeof(double));
+static_assert(std::is_trivially_copyable_v<LengthVal>);
+static_assert(sizeof(Position) == UniverseDim * sizeof(double));
+
+template <SomeUnit U>
+constexpr double
+value(const U& u) {
+  return u->getVal();
+}
+
+// Exact equality, for values that are compared because they were copied
+// or set, not computed: positions checked for a move, keys of a cache,
+// parameters at their default. -Wfloat-equal is meant for everything else.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+constexpr bool
+same(double a, double b) {
+  return a == b;
+}
+#pragma GCC diagnostic pop
+
+struct Point {
+  double x = 0.;
+  double y = 0.;
+  double z = 0.;
+};
+
+inline Point
+point(const Position& pos) {
+  return {value(pos.X()), value(pos.Y()), value(pos.Z())};
+}
+
+inline Position
+position(const Point& p) {
+  return {LengthVal{p.x}, LengthVal{p.y}, LengthVal{p.z}};
+}
+
+// Axis-aligned bounds with exact comparisons, unlike std::min/std::max on
+// Position, which order lexicographically with an epsilon.
+struct Box {
+  Point lo{};
+  Point hi{};
+
+  bool empty = true;
+
+  void
+  extend(double x, double y, double z) {
+    if(empty) {
+      lo = hi = {x, y, z};
+      empty = false;
+      return;
+    }
+    lo = {std::min(lo.x, x), std::min(lo.y, y), std::min(lo.z, z)};
+    hi = {std::max(hi.x, x), std::max(hi.y, y), std::max(hi.z, z)};
+  }
+
+  void
+  extend(const Point& p) {
+    extend(p.x, p.y, p.z);
+  }
+
+  std::pair<Position, Position>
+  rect() const {
+    return {position(lo), position(hi)};
+  }
+};
+
+template <typename Real>
+Box
+bounds(const BasicField<Real>& field) {
+  const double* x = field.xs();
+  const double* y = field.ys();
+  const double* z = field.zs();
+  Box box;
+  for(size_t i = 0; i < field.size(); ++i) {
+    box.extend(x[i], y[i], z[i]);
+  }
+  return box;
+}
+
+// Bounds of the cells of a grid in the plane z.
+inline Box
+bounds(const GridLayout& grid, double z) {
+  Box box;
+  for(size_t i = 0; i < grid.points(); ++i) {
+    const size_t cell = grid.cell(i);
+    box.extend(grid.x0 + grid.dx * static_cast<double>(cell / grid.ny),
+               grid.y0 + grid.dy * static_cast<double>(cell % grid.ny), z);
+  }
+  return box;
+}
+
+// Wavelength and loss of an environment in metres.
+inline double
+wavelength(const WavyEnvironment& env) {
+  return value(env.waveLength);
+}
+
+inline double
+loss(const WavyEnvironment& env) {
+  return value(env.eLossCoeff);
+}
+
+}  // namespace raw
+}  // namespace phys
+
+#endif /* ENGINE_RAW_HPP */
@@ -0,0 +1,35 @@
+#ifndef ENGINE_SCENE_HPP
+#define ENGINE_SCENE_HPP
+
+#include "physconstants.hpp"
+#include "surface.hpp"
+#include <memory>
+#include <vector>
+
+namespace phys {
+
+// Everything of a chamber in front of its screen. A preset builds one,
+// Chamber::load takes its surfaces over, and every front end adds a
+// screen of its own where screenFrom and screenTo say.
+struct Scene {
+  // In z order, sources first.
+  std::vector<std::unique_ptr<Surface>> surfaces{};
+  // Refractive index of the gap behind surface i; missing ones are 1.
+  std::vector<RefractiveIndex> ns{};
+  std::vector<Frequency> frequencies{consts::red};
+
+  // The surface whose power the controls set, null if there is none.
+  PointLights* lights = nullptr;
+
+  // Screen window (see ContigSurface::setWindow) and points per side.
+  Position screenFrom{};
+  Position screenTo{};
+  size_t resolution = 500;
+
+  // Cheap enough to recompute while a control moves.
+  bool interactive = true;
+};
+
+}  // namespace phys
+
+#endif /* ENGINE_SCENE_HPP */
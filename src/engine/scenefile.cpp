@@ -0,0 +1,765 @@
+#include "scenefile.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <vector>
+
+namespace phys {
+namespace scenefile {
+
+namespace {
+
+// Holes handed to a barrier at once.
+constexpr const size_t Batch = 4096;
+
+//====================================================================================/
+//=====================================< Lines >======================================/
+//====================================================================================/
+
+// The lines of a file through one buffer, none of them copied.
+class Lines {
+ public:
+  explicit Lines(const std::string& path) : m_path(path), m_in(path, std::ios::binary) {}
+
+  bool isOpen() const {return m_in.is_open();}
+
+  const std::string& path() const {return m_path;}
+
+  // Of the line next() returned last, from 1.
+  size_t number() const {return m_number;}
+
+  // The next line without its end, valid until the next call.
+  bool next(std::string_view& line);
+
+ private:
+  std::string m_path;
+  std::ifstream m_in;
+  std::vector<char> m_buffer = std::vector<char>(size_t{1} << 16);
+  size_t m_begin = 0;
+  size_t m_end = 0;
+  size_t m_number = 0;
+  bool m_done = false;
+};
+
+bool
+Lines::next(std::string_view& line) {
+  for(;;) {
+    const char* first = m_buffer.data() + m_begin;
+    const char* last = m_buffer.data() + m_end;
+    const char* eol = std::find(first, last, '\n');
+    if(eol != last || (m_done && first != last)) {
+      line = std::string_view(first, static_cast<size_t>(eol - first));
+      if(!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+      m_begin = static_cast<size_t>(eol - m_buffer.data()) + (eol != last ? 1 : 0);
+      ++m_number;
+      return true;
+    }
+    if(m_done) {
+      return false;
+    }
+
+    // Keeps the partial line in front and fills up behind it; a line
+    // longer than the buffer grows it.
+    std::memmove(m_buffer.data(), first, m_end - m_begin);
+    m_end -= m_begin;
+    m_begin = 0;
+    if(m_end == m_buffer.size()) {
+      m_buffer.resize(2 * m_buffer.size());
+    }
+    m_in.read(m_buffer.data() + m_end, static_cast<std::streamsize>(m_buffer.size() - m_end));
+    const size_t n = static_cast<size_t>(m_in.gcount());
+    m_end += n;
+    m_done = n == 0;
+  }
+}
+
+// The words of one line in front of its comment.
+class Words {
+ public:
+  explicit Words(std::string_view line) : m_rest(line.substr(0, line.find('#'))) {}
+
+  // False at the end of the line.
+  bool
+  word(std::string_view& out) {
+    const size_t begin = m_rest.find_first_not_of(" \t");
+    if(begin == std::string_view::npos) {
+      m_rest = {};
+      return false;
+    }
+    m_rest.remove_prefix(begin);
+    out = m_rest.substr(0, std::min(m_rest.find_first_of(" \t"), m_rest.size()));
+    m_rest.remove_prefix(out.size());
+    return true;
+  }
+
+  // False at the end of the line or if the next word is no number.
+  bool
+  number(double& value) {
+    std::string_view next;
+    if(!word(next)) {
+      return false;
+    }
+    const auto [end, error] = std::from_chars(next.data(), next.data() + next.size(), value);
+    return error == std::errc() && end == next.data() + next.size();
+  }
+
+  bool
+  done() const {
+    return m_rest.find_first_not_of(" \t") == std::string_view::npos;
+  }
+
+ private:
+  std::string_view m_rest;
+};
+
+bool
+isNumber(std::string_view word) {
+  return std::isdigit(static_cast<unsigned char>(word.front())) || word.front() == '-' || word.front() == '.';
+}
+
+//====================================================================================/
+//=====================================< Images >=====================================/
+//====================================================================================/
+
+// Grey levels of a PGM image, 0 black to 1 white. Row r is levels
+// r * width to r * width + width.
+struct Image {
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<float> levels{};
+
+  // Nearest pixel to u, v in [0, 1) of the width and the height.
+  float
+  at(double u, double v) const {
+    const size_t col = std::min(width - 1, static_cast<size_t>(std::max(0., u * static_cast<double>(width))));
+    const size_t row = std::min(height - 1, static_cast<size_t>(std::max(0., v * static_cast<double>(height))));
+    return levels[row * width + col];
+  }
+};
+
+// Binary (P5, 8 or 16 bit) and plain (P2) PGM.
+bool
+readPgm(const std::string& path, Image& image, std::string& error) {
+  std::ifstream in(path, std::ios::binary);
+  if(!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+  const std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+  size_t pos = 0;
+  auto header = [&](size_t& value) -> bool {
+    for(;;) {
+      pos = data.find_first_not_of(" \t\r\n", pos);
+      if(pos == std::string::npos) {
+        return false;
+      }
+      if(data[pos] != '#') {
+        break;
+      }
+      pos = data.find('\n', pos);
+    }
+    const auto [end, ec] = std::from_chars(data.data() + pos, data.data() + data.size(), value);
+    pos = static_cast<size_t>(end - data.data());
+    return ec == std::errc();
+  };
+
+  const bool binary = data.compare(0, 2, "P5") == 0;
+  size_t maxval = 0;
+  pos = 2;
+  if((!binary && data.compare(0, 2, "P2") != 0) || !header(image.width) || !header(image.height) ||
+     !header(maxval) || image.width == 0 || image.height == 0 || maxval == 0 || maxval > 65535) {
+    error = path + " is no PGM image";
+    return false;
+  }
+
+  const size_t pixels = image.width * image.height;
+  image.levels.resize(pixels);
+  const float scale = 1.f / static_cast<float>(maxval);
+  if(binary) {
+    // A single blank separates the header from the pixels.
+    ++pos;
+    const size_t bytes = maxval < 256 ? 1 : 2;
+    if(data.size() < pos + pixels * bytes) {
+      error = path + " is cut short";
+      return false;
+    }
+    const auto* raw = reinterpret_cast<const unsigned char*>(data.data() + pos);
+    for(size_t i = 0; i < pixels; ++i) {
+      const size_t level = bytes == 1 ? raw[i] : size_t{raw[2 * i]} << 8 | raw[2 * i + 1];
+      image.levels[i] = static_cast<float>(level) * scale;
+    }
+    return true;
+  }
+
+  for(size_t i = 0; i < pixels; ++i) {
+    size_t level = 0;
+    if(!header(level)) {
+      error = path + " is cut short";
+      return false;
+    }
+    image.levels[i] = static_cast<float>(level) * scale;
+  }
+  return true;
+}
+
+//====================================================================================/
+//====================================< Profiles >====================================/
+//====================================================================================/
+
+// Rectangle a grid samples, in metres.
+struct Window {
+  double x0 = 0.;
+  double y0 = 0.;
+  double width = 0.;
+  double height = 0.;
+};
+
+struct Mask {
+  enum class Kind {Circle, Zones, Image};
+
+  Kind kind = Kind::Circle;
+  // Circle: x, y, r. Zones: a, b, wavelength.
+  std::array<double, 7> p{};
+  Image image{};
+  float threshold = 0.5f;
+
+  bool
+  open(double x, double y, double z, const Window& window) const {
+    switch(kind) {
+      case Kind::Circle:
+        return (x - p[0]) * (x - p[0]) + (y - p[1]) * (y - p[1]) <= p[2] * p[2];
+      case Kind::Zones: {
+        const double a = std::sqrt((x - p[0]) * (x - p[0]) + (y - p[1]) * (y - p[1]) + (z - p[2]) * (z - p[2]));
+        const double b = std::sqrt((x - p[3]) * (x - p[3]) + (y - p[4]) * (y - p[4]) + (z - p[5]) * (z - p[5]));
+        const double waves = (a + b) / p[6];
+        return waves - std::floor(waves) <= 0.5;
+      }
+      case Kind::Image:
+      default:
+        return image.at((x - window.x0) / window.width, (y - window.y0) / window.height) >= threshold;
+    }
+  }
+};
+
+// How far a grid point moves in z.
+struct Relief {
+  enum class Kind {Flat, Sphere, Image};
+
+  Kind kind = Kind::Flat;
+  // Sphere: x, y, r. Image: depth.
+  std::array<double, 3> p{};
+  Image image{};
+  // Heights are taken modulo fold if it is positive.
+  double fold = 0.;
+
+  double
+  height(double x, double y, const Window& window) const {
+    double h = 0.;
+    switch(kind) {
+      case Kind::Flat:
+        return 0.;
+      case Kind::Sphere:
+        h = std::sqrt(std::max(0., p[2] * p[2] - (x - p[0]) * (x - p[0]) - (y - p[1]) * (y - p[1])));
+        break;
+      case Kind::Image:
+      default:
+        h = p[0] * image.at((x - window.x0) / window.width, (y - window.y0) / window.height);
+        break;
+    }
+    return fold > 0. ? h - std::floor(h / fold) * fold : h;
+  }
+};
+
+// Shape of a ShapedSurface read from a file: points closed by any mask
+// are dropped, the rest moved by the relief.
+struct Profile {
+  Window window;
+  std::vector<Mask> masks;
+  Relief relief;
+
+  void
+  operator()(ContigSurface::Row& row) const {
+    for(size_t k = 0; k < row.n; ++k) {
+      for(const Mask& mask : masks) {
+        if(!mask.open(row.x[k], row.y[k], row.z[k], window)) {
+          row.keep[k] = 0;
+        }
+      }
+      row.z[k] += relief.height(row.x[k], row.y[k], window);
+    }
+  }
+
+  // Zones are cut for the z the grid is at, a moved plate is cut again.
+  bool
+  dependsOnZ() const {
+    return std::any_of(masks.begin(), masks.end(), [](const Mask& mask) -> bool {return mask.kind == Mask::Kind::Zones;});
+  }
+};
+
+//====================================================================================/
+//=====================================< Reader >=====================================/
+//====================================================================================/
+
+class Reader {
+ public:
+  explicit Reader(const std::string& path) : m_lines(path), m_dir(std::filesystem::path(path).parent_path()) {
+    m_x.reserve(Batch);
+    m_y.reserve(Batch);
+    m_z.reserve(Batch);
+  }
+
+  // Points at its own members.
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  std::optional<Scene> read();
+
+ private:
+  // One line of the scene file.
+  bool statement(std::string_view line);
+
+  // X Y [AMPLITUDE] of the lights or holes being read.
+  bool point(Words& words);
+  bool points(std::string_view file);
+
+  bool wavelengths(Words& words);
+  bool grid(Words& words);
+  bool mask(Words& words);
+  bool shape(Words& words);
+  bool screen(Words& words);
+  bool image(Words& words, Image& image);
+
+  // Finishes the surface being read and appends it to the scene.
+  bool close();
+  // Empty lights and holes have no z of their own, the one they were
+  // given is checked.
+  bool add(std::unique_ptr<Surface> surface, double z);
+  void flush();
+
+  bool fail(const std::string& message);
+  std::string resolve(std::string_view file) const;
+
+  Lines m_lines;
+  // Where errors are, m_lines or a points file.
+  const Lines* m_at = &m_lines;
+  std::filesystem::path m_dir;
+
+  Scene m_scene{};
+  double m_lastZ = 0.;
+  bool m_screen = false;
+
+  // Points go to the lights or the holes being read, in the plane m_pointZ.
+  std::unique_ptr<PointLights> m_lights{};
+  std::unique_ptr<PointsBarrier> m_holes{};
+  double m_pointZ = 0.;
+  std::vector<double> m_x{};
+  std::vector<double> m_y{};
+  std::vector<double> m_z{};
+
+  // The grid being read; built once its masks and shape are known.
+  struct Grid {
+    double z;
+    size_t resolution;
+    double x1;
+    double y1;
+    Profile profile;
+  };
+  std::optional<Grid> m_grid{};
+};
+
+std::optional<Scene>
+Reader::read() {
+  if(!m_lines.isOpen()) {
+    std::cerr << "cannot open " << m_lines.path() << '\n';
+    return std::nullopt;
+  }
+
+  std::string_view line;
+  while(m_lines.next(line)) {
+    if(!statement(line)) {
+      return std::nullopt;
+    }
+  }
+  if(!close()) {
+    return std::nullopt;
+  }
+
+  if(m_scene.surfaces.empty() || m_scene.surfaces.front().get() != m_scene.lights) {
+    fail("a scene starts with lights");
+    return std::nullopt;
+  }
+  if(!m_screen) {
+    fail("a scene needs a screen");
+    return std::nullopt;
+  }
+  return std::move(m_scene);
+}
+
+bool
+Reader::statement(std::string_view line) {
+  Words words(line);
+  std::string_view keyword;
+  if(!words.word(keyword)) {
+    return true;
+  }
+  if(isNumber(keyword)) {
+    Words all(line);
+    return point(all);
+  }
+
+  if(keyword == "lights" || keyword == "holes") {
+    if(!close()) {
+      return false;
+    }
+    if(!words.number(m_pointZ)) {
+      return fail(std::string(keyword) + " takes a z");
+    }
+    if(keyword == "lights") {
+      m_lights = std::make_unique<PointLights>();
+    } else {
+      m_holes = std::make_unique<PointsBarrier>();
+    }
+  } else if(keyword == "points") {
+    std::string_view file;
+    if(!words.word(file)) {
+      return fail("points takes a file");
+    }
+    if(!points(file)) {
+      return false;
+    }
+  } else if(keyword == "grid") {
+    if(!grid(words)) {
+      return false;
+    }
+  } else if(keyword == "mask") {
+    if(!mask(words)) {
+      return false;
+    }
+  } else if(keyword == "shape") {
+    if(!shape(words)) {
+      return false;
+    }
+  } else if(keyword == "n") {
+    double n = 0.;
+    if(!words.number(n) || n <= 0.) {
+      return fail("n takes a refractive index");
+    }
+    const size_t surfaces = m_scene.surfaces.size() + (m_lights || m_holes || m_grid ? 1 : 0);
+    if(surfaces == 0) {
+      return fail("n comes after the surface in front of the gap");
+    }
+    m_scene.ns.resize(std::max(m_scene.ns.size(), surfaces), RefractiveIndex{1.});
+    m_scene.ns[surfaces - 1] = RefractiveIndex{n};
+  } else if(keyword == "wavelengths") {
+    if(!wavelengths(words)) {
+      return false;
+    }
+  } else if(keyword == "interactive") {
+    std::string_view value;
+    if(!words.word(value) || (value != "yes" && value != "no")) {
+      return fail("interactive is yes or no");
+    }
+    m_scene.interactive = value == "yes";
+  } else if(keyword == "screen") {
+    if(!screen(words)) {
+      return false;
+    }
+  } else {
+    return fail("unknown statement " + std::string(keyword));
+  }
+
+  if(!words.done()) {
+    return fail("too much on the line");
+  }
+  return true;
+}
+
+bool
+Reader::point(Words& words) {
+  double x = 0.;
+  double y = 0.;
+  if(!words.number(x) || !words.number(y)) {
+    return fail("a point is X Y");
+  }
+
+  if(m_lights) {
+    double amplitude = 1.;
+    if(!words.done() && !words.number(amplitude)) {
+      return fail("the amplitude of a light is a number");
+    }
+    m_lights->addSource(std::make_pair(EWave{EFieldVal{amplitude}}, Position{LengthVal{x}, LengthVal{y}, LengthVal{m_pointZ}}));
+  } else if(m_holes) {
+    m_x.push_back(x);
+    m_y.push_back(y);
+    m_z.push_back(m_pointZ);
+    if(m_x.size() == Batch) {
+      flush();
+    }
+  } else {
+    return fail("points belong to lights or holes");
+  }
+
+  if(!words.done()) {
+    return fail("too much on the line");
+  }
+  return true;
+}
+
+bool
+Reader::points(std::string_view file) {
+  Lines lines(resolve(file));
+  if(!lines.isOpen()) {
+    return fail("cannot open " + lines.path());
+  }
+
+  m_at = &lines;
+  bool ok = true;
+  std::string_view line;
+  while(ok && lines.next(line)) {
+    Words words(line);
+    ok = words.done() || point(words);
+  }
+  m_at = &m_lines;
+  return ok;
+}
+
+bool
+Reader::wavelengths(Words& words) {
+  static const std::map<std::string_view, Frequency> Named{
+    {"red", consts::red}, {"green", consts::green}, {"blue", consts::blue}};
+
+  m_scene.frequencies.clear();
+  std::string_view word;
+  while(words.word(word)) {
+    auto named = Named.find(word);
+    double length = 0.;
+    if(named != Named.end()) {
+      m_scene.frequencies.push_back(named->second);
+    } else if(std::from_chars(word.data(), word.data() + word.size(), length).ptr == word.data() + word.size() && length > 0.) {
+      m_scene.frequencies.push_back(consts::c / LengthVal{length});
+    } else {
+      return fail("unknown wavelength " + std::string(word));
+    }
+  }
+  if(m_scene.frequencies.empty() || m_scene.frequencies.size() > Field::MaxChannels) {
+    return fail("a scene has 1 to " + std::to_string(Field::MaxChannels) + " wavelengths");
+  }
+  return true;
+}
+
+bool
+Reader::grid(Words& words) {
+  if(!close()) {
+    return false;
+  }
+  double z = 0.;
+  double resolution = 0.;
+  Window window;
+  double x1 = 0.;
+  double y1 = 0.;
+  if(!words.number(z) || !words.number(resolution) || !words.number(window.x0) || !words.number(window.y0) ||
+     !words.number(x1) || !words.number(y1)) {
+    return fail("grid is Z RESOLUTION X0 Y0 X1 Y1");
+  }
+  if(resolution < 1. || !raw::same(resolution, std::floor(resolution)) || x1 <= window.x0 || y1 <= window.y0) {
+    return fail("a grid has a whole resolution and X1 > X0, Y1 > Y0");
+  }
+  window.width = x1 - window.x0;
+  window.height = y1 - window.y0;
+  m_grid = Grid{z, static_cast<size_t>(resolution), x1, y1, Profile{window, {}, {}}};
+  return true;
+}
+
+bool
+Reader::mask(Words& words) {
+  if(!m_grid) {
+    return fail("a mask belongs to a grid");
+  }
+  std::string_view kind;
+  words.word(kind);
+
+  Mask mask;
+  if(kind == "circle") {
+    mask.kind = Mask::Kind::Circle;
+    if(!words.number(mask.p[0]) || !words.number(mask.p[1]) || !words.number(mask.p[2])) {
+      return fail("mask circle is X Y R");
+    }
+  } else if(kind == "zones") {
+    mask.kind = Mask::Kind::Zones;
+    for(double& p : mask.p) {
+      if(!words.number(p)) {
+        return fail("mask zones is AX AY AZ BX BY BZ WAVELENGTH");
+      }
+    }
+    if(mask.p[6] <= 0.) {
+      return fail("mask zones takes a positive wavelength");
+    }
+  } else if(kind == "image") {
+    mask.kind = Mask::Kind::Image;
+    if(!image(words, mask.image)) {
+      return false;
+    }
+    double threshold = 0.5;
+    if(!words.done() && !words.number(threshold)) {
+      return fail("mask image is FILE [THRESHOLD]");
+    }
+    mask.threshold = static_cast<float>(threshold);
+  } else {
+    return fail("a mask is a circle, zones or an image");
+  }
+  m_grid->profile.masks.push_back(std::move(mask));
+  return true;
+}
+
+bool
+Reader::shape(Words& words) {
+  if(!m_grid) {
+    return fail("a shape belongs to a grid");
+  }
+  Relief& relief = m_grid->profile.relief;
+  if(relief.kind != Relief::Kind::Flat) {
+    return fail("a grid has one shape");
+  }
+  std::string_view kind;
+  words.word(kind);
+
+  if(kind == "sphere") {
+    relief.kind = Relief::Kind::Sphere;
+    if(!words.number(relief.p[0]) || !words.number(relief.p[1]) || !words.number(relief.p[2])) {
+      return fail("shape sphere is X Y R [FOLD]");
+    }
+  } else if(kind == "image") {
+    relief.kind = Relief::Kind::Image;
+    if(!image(words, relief.image)) {
+      return false;
+    }
+    if(!words.number(relief.p[0])) {
+      return fail("shape image is FILE DEPTH [FOLD]");
+    }
+  } else {
+    return fail("a shape is a sphere or an image");
+  }
+  if(!words.done() && (!words.number(relief.fold) || relief.fold <= 0.)) {
+    return fail("a fold is a positive length");
+  }
+  return true;
+}
+
+bool
+Reader::image(Words& words, Image& image) {
+  std::string_view file;
+  if(!words.word(file)) {
+    return fail("an image takes a file");
+  }
+  std::string error;
+  if(!readPgm(resolve(file), image, error)) {
+    return fail(error);
+  }
+  return true;
+}
+
+bool
+Reader::screen(Words& words) {
+  double z = 0.;
+  double resolution = 0.;
+  double x0 = 0.;
+  double y0 = 0.;
+  double x1 = 0.;
+  double y1 = 0.;
+  if(!words.number(z) || !words.number(resolution) || !words.number(x0) || !words.number(y0) ||
+     !words.number(x1) || !words.number(y1)) {
+    return fail("screen is Z RESOLUTION X0 Y0 X1 Y1");
+  }
+  if(resolution < 1. || !raw::same(resolution, std::floor(resolution)) || x1 <= x0 || y1 <= y0) {
+    return fail("a screen has a whole resolution and X1 > X0, Y1 > Y0");
+  }
+  m_scene.screenFrom = Position{LengthVal{x0}, LengthVal{y0}, LengthVal{z}};
+  m_scene.screenTo = Position{LengthVal{x1}, LengthVal{y1}, LengthVal{z}};
+  m_scene.resolution = static_cast<size_t>(resolution);
+  m_screen = true;
+  return true;
+}
+
+bool
+Reader::close() {
+  if(m_lights) {
+    if(m_scene.surfaces.empty() || m_scene.surfaces.front().get() != m_scene.lights) {
+      m_scene.lights = m_lights.get();
+    }
+    return add(std::move(m_lights), m_pointZ);
+  }
+  if(m_holes) {
+    flush();
+    return add(std::move(m_holes), m_pointZ);
+  }
+  if(m_grid) {
+    Grid grid = std::move(*m_grid);
+    m_grid.reset();
+
+    const Window& window = grid.profile.window;
+    const Position from{LengthVal{window.x0}, LengthVal{window.y0}, LengthVal{grid.z}};
+    const Position to{LengthVal{grid.x1}, LengthVal{grid.y1}, LengthVal{grid.z}};
+    std::unique_ptr<ContigSurface> surface;
+    if(grid.profile.masks.empty() && grid.profile.relief.kind == Relief::Kind::Flat) {
+      surface = std::make_unique<ContigSurface>(to);
+    } else {
+      surface = std::make_unique<ShapedSurface<Profile>>(to, std::move(grid.profile));
+    }
+    surface->setWindow(from, to);
+    surface->setResolution(grid.resolution);
+    return add(std::move(surface), grid.z);
+  }
+  return true;
+}
+
+bool
+Reader::add(std::unique_ptr<Surface> surface, double z) {
+  if(!m_scene.surfaces.empty() && z < m_lastZ) {
+    return fail("surfaces come in z order");
+  }
+  m_lastZ = z;
+  m_scene.surfaces.push_back(std::move(surface));
+  return true;
+}
+
+void
+Reader::flush() {
+  m_holes->addHoles(m_x.data(), m_y.data(), m_z.data(), m_x.size());
+  m_x.clear();
+  m_y.clear();
+  m_z.clear();
+}
+
+bool
+Reader::fail(const std::string& message) {
+  std::cerr << m_at->path() << ':' << m_at->number() << ": " << message << '\n';
+  return false;
+}
+
+std::string
+Reader::resolve(std::string_view file) const {
+  const std::filesystem::path path(file);
+  return (path.is_absolute() ? path : m_dir / path).string();
+}
+
+}  // namespace
+
+std::optional<Scene>
+read(const std::string& path) {
+  return Reader(path).read();
+}
+
+}  // namespace scenefile
+}  // namespace phys
@@ -0,0 +1,54 @@
+#ifndef ENGINE_SCENEFILE_HPP
+#define ENGINE_SCENEFILE_HPP
+
+#include "scene.hpp"
+#include <optional>
+#include <string>
+
+// Scenes as text, one statement per line, # starts a comment. Lengths are
+// in metres, surfaces come in z order:
+//
+//   wavelengths red 5.5e-7           names red, green, blue or metres
+//   interactive no                   recompute only on request
+//
+//   lights Z                         point sources in the plane Z, then
+//   X Y [AMPLITUDE]                    one per line, amplitude 1
+//   holes Z                          a barrier with holes in the plane Z
+//   X Y                                one per line
+//   points FILE                      more lines of X Y [AMPLITUDE] for the
+//                                      lights or holes above, from FILE
+//
+//   grid Z RESOLUTION X0 Y0 X1 Y1    a square grid of the rectangle from
+//                                      X0 Y0 to X1 Y1 (exclusive), then
+//   mask circle X Y R                  open inside the circle
+//   mask zones AX AY AZ BX BY BZ L     open where the path from A to B
+//                                      through the point is in the first
+//                                      half of a wave of length L
+//   mask image FILE [THRESHOLD]        open where the PGM image is at
+//                                      least THRESHOLD of white (0.5)
+//   shape sphere X Y R [FOLD]          moved by the height of a sphere
+//   shape image FILE DEPTH [FOLD]      moved by DEPTH times the image
+//                                      a point may have several masks and
+//                                      one shape; FOLD takes the height
+//                                      modulo FOLD, as in a Fresnel lens
+//
+//   n INDEX                          refractive index behind the surface
+//                                      above, 1 by default
+//   screen Z RESOLUTION X0 Y0 X1 Y1  where the screen is sampled
+//
+// Images span the grid, their columns along x and their rows along y.
+// Relative paths are taken from the directory of the scene file. Points
+// are read in batches straight into the surfaces, so hole lists of any
+// length take no memory beyond their fields.
+
+namespace phys {
+namespace scenefile {
+
+// Empty if the file cannot be read or is not a scene; the reason, with
+// its file and line, goes to std::cerr.
+std::optional<Scene> read(const std::string& path);
+
+}  // namespace scenefile
+}  // namespace phys
+
+#endif /* ENGINE_SCENEFILE_HPP */
@@ -0,0 +1,169 @@
+#include "screen.hpp"
+#include "kernels.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <array>
+
+namespace phys {
+
+namespace {
+
+// Points summed at once: their positions and amplitudes, 8 + 16 bytes per
+// channel each, stay in L1 while the kernel runs over the sources.
+constexpr const size_t Tile = 256;
+
+template <typename Source>
+void
+sum(const Source& src, Intensity& dst, const kernels::Medium& medium, const PropagationConfig& config) {
+  const GridLayout& grid = dst.grid;
+  const double z = raw::value(dst.z);
+  const size_t channels = medium.channels;
+
+  const size_t grain = parallel::MinPairsPerTask / std::max<size_t>(src.size(), 1);
+  parallel::forRanges(dst.points(), grain, [&](size_t begin, size_t end) {
+    std::array<double, Tile> x;
+    std::array<double, Tile> y;
+    std::array<double, Tile> zs;
+    zs.fill(z);
+    std::vector<double> amplitudes(2 * channels * Tile);
+    std::array<double*, Field::MaxChannels> re;
+    std::array<double*, Field::MaxChannels> im;
+    for(size_t ch = 0; ch < channels; ++ch) {
+      re[ch] = amplitudes.data() + 2 * ch * Tile;
+      im[ch] = re[ch] + Tile;
+    }
+    const kernels::Targets targets{x.data(), y.data(), zs.data(), re.data(), im.data()};
+
+    for(size_t first = begin; first < end; first += Tile) {
+      const size_t n = std::min(Tile, end - first);
+      for(size_t k = 0; k < n; ++k) {
+        const size_t cell = first + k;
+        x[k] = grid.x0 + grid.dx * static_cast<double>(cell / grid.ny);
+        y[k] = grid.y0 + grid.dy * static_cast<double>(cell % grid.ny);
+      }
+
+      switch(config.kernel) {
+        case Kernel::Simd:
+          kernels::simd(src, targets, 0, n, medium, config);
+          break;
+        case Kernel::Scalar:
+        default:
+          kernels::scalar(src, targets, 0, n, medium, config);
+          break;
+      }
+
+      for(size_t ch = 0; ch < channels; ++ch) {
+        float* out = dst.channel(ch) + first;
+        for(size_t k = 0; k < n; ++k) {
+          out[k] = static_cast<float>(re[ch][k] * re[ch][k] + im[ch][k] * im[ch][k]);
+        }
+      }
+    }
+  });
+}
+
+}  // namespace
+
+Screen::Screen(Position corner) : m_corner(corner) {
+  regrid();
+}
+
+void
+Screen::regrid() {
+  GridLayout& grid = m_intensity.grid;
+  grid.x0 = raw::value(m_origin.X());
+  grid.y0 = raw::value(m_origin.Y());
+  grid.dx = raw::value(m_corner.X() - m_origin.X()) / static_cast<double>(m_resolution);
+  grid.dy = raw::value(m_corner.Y() - m_origin.Y()) / static_cast<double>(m_resolution);
+  grid.nx = grid.ny = m_resolution;
+  grid.cells.clear();
+
+  m_intensity.z = m_corner.Z();
+  m_intensity.channels = m_envs.size();
+  m_intensity.values.resize(m_intensity.channels * grid.points());
+  touch();
+}
+
+void
+Screen::setEnvironments(std::vector<WavyEnvironment> envs) {
+  m_envs = std::move(envs);
+  m_intensity.channels = m_envs.size();
+  m_intensity.values.resize(m_intensity.channels * m_intensity.points());
+  touch();
+}
+
+void
+Screen::update(const Field& src) {
+  if(src.channels() != m_envs.size()) {
+    std::cerr << "Channel count differs between the field and environments\n";
+    abort();
+  }
+
+  if(m_config.method != Method::Direct && methodFits(src, m_intensity.grid, m_intensity.z)) {
+    Field dst = points();
+    propagate(src, dst);
+    for(size_t ch = 0; ch < m_envs.size(); ++ch) {
+      const double* re = dst.re(ch);
+      const double* im = dst.im(ch);
+      float* out = m_intensity.channel(ch);
+      for(size_t i = 0; i < dst.size(); ++i) {
+        out[i] = static_cast<float>(re[i] * re[i] + im[i] * im[i]);
+      }
+    }
+    return;
+  }
+
+  std::array<double, Field::MaxChannels> lambda;
+  for(size_t ch = 0; ch < m_envs.size(); ++ch) {
+    lambda[ch] = raw::wavelength(m_envs[ch]);
+  }
+  const kernels::Medium medium{raw::loss(m_envs.front()), lambda.data(), m_envs.size()};
+
+  if(m_config.precision == Precision::Mixed) {
+    sum(FieldF(src), m_intensity, medium, m_config);
+  } else {
+    sum(src, m_intensity, medium, m_config);
+  }
+}
+
+void
+Screen::rescale(const std::vector<std::complex<double>>& factors) {
+  for(size_t ch = 0; ch < m_intensity.channels; ++ch) {
+    const float k = static_cast<float>(std::norm(factors[ch]));
+    float* values = m_intensity.channel(ch);
+    for(size_t i = 0; i < m_intensity.points(); ++i) {
+      values[i] *= k;
+    }
+  }
+}
+
+void
+Screen::publish() {
+  m_frames.store(m_intensity);
+}
+
+Field
+Screen::points() const {
+  const GridLayout& grid = m_intensity.grid;
+  Field out;
+  out.setChannels(m_envs.size());
+  out.reserve(grid.points());
+  for(size_t i = 0; i < grid.nx; ++i) {
+    for(size_t j = 0; j < grid.ny; ++j) {
+      out.push(EWave{}, Position{LengthVal{grid.x0 + grid.dx * static_cast<double>(i)},
+                                 LengthVal{grid.y0 + grid.dy * static_cast<double>(j)}, m_intensity.z});
+    }
+  }
+  out.setGrid(grid);
+  return out;
+}
+
+std::pair<Position, Position>
+Screen::getRect() const {
+  const GridLayout& grid = m_intensity.grid;
+  const LengthVal x1{grid.x0 + grid.dx * static_cast<double>(grid.nx - 1)};
+  const LengthVal y1{grid.y0 + grid.dy * static_cast<double>(grid.ny - 1)};
+  return {Position{LengthVal{grid.x0}, LengthVal{grid.y0}, m_intensity.z}, Position{x1, y1, m_intensity.z}};
+}
+
+}  // namespace phys
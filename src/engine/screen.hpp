@@ -0,0 +1,117 @@
+#ifndef ENGINE_SCREEN_HPP
+#define ENGINE_SCREEN_HPP
+
+#include "grid.hpp"
+#include "surface.hpp"
+#include <memory>
+#include <vector>
+
+namespace phys {
+
+// |E|^2 of every channel on all cells of a grid in a plane of constant z.
+// Positions follow from the grid and are not stored.
+struct Intensity {
+  GridLayout grid{};
+  LengthVal z{};
+  size_t channels = 0;
+  // Channel ch of point i is values[ch * points() + i].
+  AlignedVector<float> values{};
+
+  size_t points() const {return grid.points();}
+
+  const float* channel(size_t ch) const {return values.data() + ch * points();}
+  float* channel(size_t ch) {return values.data() + ch * points();}
+};
+
+//====================================================================================/
+//=======================================< Screen >===================================/
+//====================================================================================/
+
+// The end of a chamber: a square grid that only records the intensity it
+// receives, 4 bytes per point and channel. A direct hop is summed in tiles
+// of points whose positions come from the grid and whose amplitudes stay
+// in cache until squared, so no complex field of the screen is ever held.
+// It emits nothing, so it must be the last surface.
+class Screen : public Surface {
+ public:
+  // The square from the axis origin to corner, at the z of corner.
+  explicit Screen(Position corner);
+
+  void setResolution(size_t resolution) {
+    m_resolution = resolution;
+    regrid();
+  }
+
+  // Samples the rectangle from `from` to `to` (exclusive) instead of the one
+  // from the axis origin; z is taken from `to`.
+  void setWindow(Position from, Position to) {
+    m_origin = from;
+    m_corner = to;
+    regrid();
+  }
+
+  // Only the plane moves, the grid stays.
+  virtual void
+  setZ(LengthVal z) override {
+    m_corner.Z() = z;
+    m_intensity.z = z;
+    touch();
+  }
+
+  virtual void setEnvironments(std::vector<WavyEnvironment> envs) override;
+
+  // A method that fits the hop writes a whole field, squared once it is
+  // complete. Everything else, Method::Direct and the fallbacks of the
+  // other methods, is summed tile by tile.
+  virtual void update(const Field& src) override;
+
+  // Intensity follows amplitude factors exactly, but not a change of some
+  // of the sources, which interferes with the rest of the field.
+  virtual void rescale(const std::vector<std::complex<double>>& factors) override;
+
+  virtual bool
+  updateDelta(const Field&) override {return false;}
+
+  // Publishes the intensity, see frame(). Snapshots of the field stay null.
+  virtual void publish() override;
+
+  // The intensity as the last publish() left it, null before the first
+  // one; see Published.
+  std::shared_ptr<const Intensity>
+  frame() const {
+    return m_frames.load();
+  }
+
+  // Current intensity, only for the updating thread.
+  const Intensity&
+  intensity() const {return m_intensity;}
+
+  const GridLayout&
+  grid() const {return m_intensity.grid;}
+
+  // Always empty.
+  virtual const Field&
+  getField() const override {return m_none;}
+
+  virtual Field points() const override;
+
+  virtual std::pair<Position, Position> getRect() const override;
+
+ protected:
+  virtual Field& field() override {return m_none;}
+
+ private:
+  void regrid();
+
+  Position m_origin{};
+  Position m_corner{};
+  size_t m_resolution = 1;
+
+  Intensity m_intensity{};
+  Published<Intensity> m_frames{};
+  Field m_none{};
+};
+
+}  // namespace phys
+
+#endif /* ENGINE_SCREEN_HPP */
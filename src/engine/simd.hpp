@@ -0,0 +1,425 @@
+#ifndef ENGINE_SIMD_HPP
+#define ENGINE_SIMD_HPP
+
+#include "trig.hpp"
+#include <cstddef>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+// GCC 12 reports its own _mm512_undefined_* placeholders as maybe
+// uninitialized wherever the intrinsics get inlined (GCC PR105593).
+#    if defined(__GNUG__) && !defined(__clang__)
+#        pragma GCC diagnostic push
+#        pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#        include <immintrin.h>
+#        pragma GCC diagnostic pop
+#    else
+#        include <immintrin.h>
+#    endif
+#endif
+
+// Thin wrappers over the widest double-precision vector unit the target was
+// compiled for (-march=native). Kernels are written once against these and
+// PHYS_SIMD_WIDTH tells whether a vector path exists at all.
+
+namespace phys {
+namespace simd {
+
+#if defined(__AVX512F__)
+
+#    define PHYS_SIMD_WIDTH 8
+
+using vd = __m512d;
+constexpr const size_t Width = 8;
+
+inline vd set1(double x) {return _mm512_set1_pd(x);}
+inline vd zero() {return _mm512_setzero_pd();}
+inline vd load(const double* p) {return _mm512_loadu_pd(p);}
+inline vd add(vd a, vd b) {return _mm512_add_pd(a, b);}
+inline vd sub(vd a, vd b) {return _mm512_sub_pd(a, b);}
+inline vd mul(vd a, vd b) {return _mm512_mul_pd(a, b);}
+inline vd div(vd a, vd b) {return _mm512_div_pd(a, b);}
+inline vd sqrt(vd a) {return _mm512_sqrt_pd(a);}
+inline vd fmadd(vd a, vd b, vd c) {return _mm512_fmadd_pd(a, b, c);}   // a * b + c
+inline vd fnmadd(vd a, vd b, vd c) {return _mm512_fnmadd_pd(a, b, c);} // c - a * b
+inline vd round(vd a) {return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT);}
+inline vd floor(vd a) {return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEG_INF);}
+inline double hsum(vd a) {return _mm512_reduce_add_pd(a);}
+
+inline __mmask8 tailMask(size_t n) {
+  return static_cast<__mmask8>((1u << n) - 1u);
+}
+
+// First n lanes of p, zeros in the rest. Never reads past p + n.
+inline vd loadTail(const double* p, size_t n) {
+  return _mm512_maskz_loadu_pd(tailMask(n), p);
+}
+
+// Zeroes every lane starting from n.
+inline vd keepTail(vd a, size_t n) {
+  return _mm512_maskz_mov_pd(tailMask(n), a);
+}
+
+// q holds whole numbers of quarter turns; maps (sin r, cos r) to (sin, cos)
+// of r + q * pi / 2.
+inline void applyQuadrant(vd q, vd& s, vd& c) {
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512i two = _mm512_set1_epi64(2);
+  // 1.5 * 2^52 moves the integer value of q into the low mantissa bits.
+  __m512i qi = _mm512_castpd_si512(_mm512_add_pd(q, _mm512_set1_pd(6755399441055744.0)));
+
+  __mmask8 swap   = _mm512_test_epi64_mask(qi, one);
+  __m512i sinSign = _mm512_slli_epi64(_mm512_and_si512(qi, two), 62);
+  __m512i cosSign = _mm512_slli_epi64(_mm512_and_si512(_mm512_add_epi64(qi, one), two), 62);
+
+  vd ss = _mm512_mask_blend_pd(swap, s, c);
+  vd cc = _mm512_mask_blend_pd(swap, c, s);
+  s = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(ss), sinSign));
+  c = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(cc), cosSign));
+}
+
+// base[low bits of the integer that t - RoundMagic holds, masked by mask].
+inline vd lookup(const double* base, vd t, long long mask) {
+  __m512i idx = _mm512_and_si512(_mm512_castpd_si512(t), _mm512_set1_epi64(mask));
+  return _mm512_i64gather_pd(idx, base, 8);
+}
+
+
+// Single-precision lanes: twice as many per register as vd.
+using vf = __m512;
+constexpr const size_t WidthF = 16;
+
+inline vf set1f(float x) {return _mm512_set1_ps(x);}
+inline vf zerof() {return _mm512_setzero_ps();}
+inline vf load(const float* p) {return _mm512_loadu_ps(p);}
+inline void store(float* p, vf a) {_mm512_storeu_ps(p, a);}
+inline vf add(vf a, vf b) {return _mm512_add_ps(a, b);}
+inline vf sub(vf a, vf b) {return _mm512_sub_ps(a, b);}
+inline vf mul(vf a, vf b) {return _mm512_mul_ps(a, b);}
+inline vf div(vf a, vf b) {return _mm512_div_ps(a, b);}
+inline vf fmadd(vf a, vf b, vf c) {return _mm512_fmadd_ps(a, b, c);}
+inline vf fnmadd(vf a, vf b, vf c) {return _mm512_fnmadd_ps(a, b, c);}
+inline vf round(vf a) {return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT);}
+
+inline __mmask16 tailMaskF(size_t n) {
+  return static_cast<__mmask16>((1u << n) - 1u);
+}
+
+inline vf loadTail(const float* p, size_t n) {
+  return _mm512_maskz_loadu_ps(tailMaskF(n), p);
+}
+
+inline vf keepTail(vf a, size_t n) {
+  return _mm512_maskz_mov_ps(tailMaskF(n), a);
+}
+
+// Packs two double vectors into the low and high halves of one float vector.
+inline vf toFloat(vd lo, vd hi) {
+  __m512d packed = _mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(lo)));
+  return _mm512_castpd_ps(_mm512_insertf64x4(packed, _mm256_castps_pd(_mm512_cvtpd_ps(hi)), 1));
+}
+
+inline vd lowHalf(vf a) {
+  return _mm512_cvtps_pd(_mm512_castps512_ps256(a));
+}
+
+inline vd highHalf(vf a) {
+  __m512d bits = _mm512_castps_pd(a);
+  return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_castpd512_pd256(_mm512_shuffle_f64x2(bits, bits, 0xEE))));
+}
+
+inline vf min(vf a, vf b) {return _mm512_min_ps(a, b);}
+inline vf max(vf a, vf b) {return _mm512_max_ps(a, b);} // b where a is NaN
+
+// 32-bit integer lanes, for tables indexed by float bit patterns.
+using vi = __m512i;
+
+// base[(bits of v - bias) >> Shift].
+template <int Shift>
+inline vi lookupBits(const int* base, vf v, int bias) {
+  __m512i idx = _mm512_sub_epi32(_mm512_castps_si512(v), _mm512_set1_epi32(bias));
+  return _mm512_i32gather_epi32(_mm512_srli_epi32(idx, Shift), base, 4);
+}
+
+// Stores 8-bit levels as 0xffRRGGBB pixels.
+inline void storeRgb(unsigned* p, vi r, vi g, vi b) {
+  __m512i px = _mm512_or_si512(_mm512_slli_epi32(r, 16), _mm512_slli_epi32(g, 8));
+  px = _mm512_or_si512(px, _mm512_or_si512(b, _mm512_set1_epi32(static_cast<int>(0xff000000u))));
+  _mm512_storeu_si512(p, px);
+}
+
+inline void applyQuadrant(vf q, vf& s, vf& c) {
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i two = _mm512_set1_epi32(2);
+  // 1.5 * 2^23 moves the integer value of q into the low mantissa bits.
+  __m512i qi = _mm512_castps_si512(_mm512_add_ps(q, _mm512_set1_ps(12582912.f)));
+
+  __mmask16 swap  = _mm512_test_epi32_mask(qi, one);
+  __m512i sinSign = _mm512_slli_epi32(_mm512_and_si512(qi, two), 30);
+  __m512i cosSign = _mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(qi, one), two), 30);
+
+  vf ss = _mm512_mask_blend_ps(swap, s, c);
+  vf cc = _mm512_mask_blend_ps(swap, c, s);
+  s = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(ss), sinSign));
+  c = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(cc), cosSign));
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+#    define PHYS_SIMD_WIDTH 4
+
+using vd = __m256d;
+constexpr const size_t Width = 4;
+
+inline vd set1(double x) {return _mm256_set1_pd(x);}
+inline vd zero() {return _mm256_setzero_pd();}
+inline vd load(const double* p) {return _mm256_loadu_pd(p);}
+inline vd add(vd a, vd b) {return _mm256_add_pd(a, b);}
+inline vd sub(vd a, vd b) {return _mm256_sub_pd(a, b);}
+inline vd mul(vd a, vd b) {return _mm256_mul_pd(a, b);}
+inline vd div(vd a, vd b) {return _mm256_div_pd(a, b);}
+inline vd sqrt(vd a) {return _mm256_sqrt_pd(a);}
+inline vd fmadd(vd a, vd b, vd c) {return _mm256_fmadd_pd(a, b, c);}   // a * b + c
+inline vd fnmadd(vd a, vd b, vd c) {return _mm256_fnmadd_pd(a, b, c);} // c - a * b
+inline vd round(vd a) {return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);}
+inline vd floor(vd a) {return _mm256_floor_pd(a);}
+
+inline double hsum(vd a) {
+  __m128d lo = _mm256_castpd256_pd128(a);
+  __m128d hi = _mm256_extractf128_pd(a, 1);
+  lo = _mm_add_pd(lo, hi);
+  return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+inline __m256i tailMask(size_t n) {
+  const __m256i lanes = _mm256_set_epi64x(3, 2, 1, 0);
+  return _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<long long>(n)), lanes);
+}
+
+// First n lanes of p, zeros in the rest. Never reads past p + n.
+inline vd loadTail(const double* p, size_t n) {
+  return _mm256_maskload_pd(p, tailMask(n));
+}
+
+// Zeroes every lane starting from n.
+inline vd keepTail(vd a, size_t n) {
+  return _mm256_and_pd(a, _mm256_castsi256_pd(tailMask(n)));
+}
+
+// q holds whole numbers of quarter turns; maps (sin r, cos r) to (sin, cos)
+// of r + q * pi / 2.
+inline void applyQuadrant(vd q, vd& s, vd& c) {
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i two = _mm256_set1_epi64x(2);
+  // 1.5 * 2^52 moves the integer value of q into the low mantissa bits.
+  __m256i qi = _mm256_castpd_si256(_mm256_add_pd(q, _mm256_set1_pd(6755399441055744.0)));
+
+  vd swap    = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(qi, one), one));
+  vd sinSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi, two), 62));
+  vd cosSign = _mm256_castsi256_pd(
+      _mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(qi, one), two), 62));
+
+  vd ss = _mm256_blendv_pd(s, c, swap);
+  vd cc = _mm256_blendv_pd(c, s, swap);
+  s = _mm256_xor_pd(ss, sinSign);
+  c = _mm256_xor_pd(cc, cosSign);
+}
+
+// base[low bits of the integer that t - RoundMagic holds, masked by mask].
+inline vd lookup(const double* base, vd t, long long mask) {
+  __m256i idx = _mm256_and_si256(_mm256_castpd_si256(t), _mm256_set1_epi64x(mask));
+  return _mm256_i64gather_pd(base, idx, 8);
+}
+
+
+// Single-precision lanes: twice as many per register as vd.
+using vf = __m256;
+constexpr const size_t WidthF = 8;
+
+inline vf set1f(float x) {return _mm256_set1_ps(x);}
+inline vf zerof() {return _mm256_setzero_ps();}
+inline vf load(const float* p) {return _mm256_loadu_ps(p);}
+inline void store(float* p, vf a) {_mm256_storeu_ps(p, a);}
+inline vf add(vf a, vf b) {return _mm256_add_ps(a, b);}
+inline vf sub(vf a, vf b) {return _mm256_sub_ps(a, b);}
+inline vf mul(vf a, vf b) {return _mm256_mul_ps(a, b);}
+inline vf div(vf a, vf b) {return _mm256_div_ps(a, b);}
+inline vf fmadd(vf a, vf b, vf c) {return _mm256_fmadd_ps(a, b, c);}
+inline vf fnmadd(vf a, vf b, vf c) {return _mm256_fnmadd_ps(a, b, c);}
+inline vf round(vf a) {return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);}
+
+inline __m256i tailMaskF(size_t n) {
+  const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(n)), lanes);
+}
+
+inline vf loadTail(const float* p, size_t n) {
+  return _mm256_maskload_ps(p, tailMaskF(n));
+}
+
+inline vf keepTail(vf a, size_t n) {
+  return _mm256_and_ps(a, _mm256_castsi256_ps(tailMaskF(n)));
+}
+
+// Packs two double vectors into the low and high halves of one float vector.
+inline vf toFloat(vd lo, vd hi) {
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+}
+
+inline vd lowHalf(vf a) {
+  return _mm256_cvtps_pd(_mm256_castps256_ps128(a));
+}
+
+inline vd highHalf(vf a) {
+  return _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1));
+}
+
+inline vf min(vf a, vf b) {return _mm256_min_ps(a, b);}
+inline vf max(vf a, vf b) {return _mm256_max_ps(a, b);} // b where a is NaN
+
+// 32-bit integer lanes, for tables indexed by float bit patterns.
+using vi = __m256i;
+
+// base[(bits of v - bias) >> Shift].
+template <int Shift>
+inline vi lookupBits(const int* base, vf v, int bias) {
+  __m256i idx = _mm256_sub_epi32(_mm256_castps_si256(v), _mm256_set1_epi32(bias));
+  return _mm256_i32gather_epi32(base, _mm256_srli_epi32(idx, Shift), 4);
+}
+
+// Stores 8-bit levels as 0xffRRGGBB pixels.
+inline void storeRgb(unsigned* p, vi r, vi g, vi b) {
+  __m256i px = _mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_slli_epi32(g, 8));
+  px = _mm256_or_si256(px, _mm256_or_si256(b, _mm256_set1_epi32(static_cast<int>(0xff000000u))));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), px);
+}
+
+inline void applyQuadrant(vf q, vf& s, vf& c) {
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+  // 1.5 * 2^23 moves the integer value of q into the low mantissa bits.
+  __m256i qi = _mm256_castps_si256(_mm256_add_ps(q, _mm256_set1_ps(12582912.f)));
+
+  vf swap    = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(qi, one), one));
+  vf sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(qi, two), 30));
+  vf cosSign = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(qi, one), two), 30));
+
+  vf ss = _mm256_blendv_ps(s, c, swap);
+  vf cc = _mm256_blendv_ps(c, s, swap);
+  s = _mm256_xor_ps(ss, sinSign);
+  c = _mm256_xor_ps(cc, cosSign);
+}
+
+#else
+
+#    define PHYS_SIMD_WIDTH 1
+
+#endif
+
+#if PHYS_SIMD_WIDTH > 1
+
+// Vector counterparts of the trig:: tiers. Both polynomial tiers use
+// Cody-Waite reduction by pi/2 (good up to ~1e9 rad, our phases are ~1e7 at
+// most); sincos() uses the Cephes minimax polynomials on [-pi/4, pi/4] and
+// agrees with libm to ~1e-15, sincosPoly() the shorter ones of trig::poly.
+inline vd reduceQuarter(vd x, vd& q) {
+  q = round(mul(x, set1(trig::TwoOverPi)));
+  vd r = fnmadd(q, set1(trig::PiOver2Hi), x);
+  r = fnmadd(q, set1(trig::PiOver2Mid), r);
+  return fnmadd(q, set1(trig::PiOver2Lo), r);
+}
+
+inline void sincos(vd x, vd& s, vd& c) {
+  vd q;
+  vd r  = reduceQuarter(x, q);
+  vd r2 = mul(r, r);
+
+  vd ps = set1(1.58962301576546568060e-10);
+  ps = fmadd(ps, r2, set1(-2.50507477628578072866e-8));
+  ps = fmadd(ps, r2, set1(2.75573136213857245213e-6));
+  ps = fmadd(ps, r2, set1(-1.98412698295895385996e-4));
+  ps = fmadd(ps, r2, set1(8.33333333332211858878e-3));
+  ps = fmadd(ps, r2, set1(-1.66666666666666307295e-1));
+  s = fmadd(mul(r, r2), ps, r);
+
+  vd pc = set1(-1.13585365213876817300e-11);
+  pc = fmadd(pc, r2, set1(2.08757008419747316778e-9));
+  pc = fmadd(pc, r2, set1(-2.75573141792967388112e-7));
+  pc = fmadd(pc, r2, set1(2.48015872888517045348e-5));
+  pc = fmadd(pc, r2, set1(-1.38888888888730564116e-3));
+  pc = fmadd(pc, r2, set1(4.16666666666665929218e-2));
+  c = fmadd(mul(r2, r2), pc, fnmadd(set1(0.5), r2, set1(1.)));
+
+  applyQuadrant(q, s, c);
+}
+
+inline void sincosPoly(vd x, vd& s, vd& c) {
+  vd q;
+  vd r  = reduceQuarter(x, q);
+  vd r2 = mul(r, r);
+
+  vd ps = set1(1. / 362880.);
+  ps = fmadd(ps, r2, set1(-1. / 5040.));
+  ps = fmadd(ps, r2, set1(1. / 120.));
+  ps = fmadd(ps, r2, set1(-1. / 6.));
+  s = fmadd(mul(r, r2), ps, r);
+
+  vd pc = set1(1. / 40320.);
+  pc = fmadd(pc, r2, set1(-1. / 720.));
+  pc = fmadd(pc, r2, set1(1. / 24.));
+  c = fmadd(mul(r2, r2), pc, fnmadd(set1(0.5), r2, set1(1.)));
+
+  applyQuadrant(q, s, c);
+}
+
+inline void sincosTable(const trig::Table& tbl, vd x, vd& s, vd& c) {
+  vd t = fmadd(x, set1(trig::TableScale), set1(trig::RoundMagic));
+  s = lookup(tbl.sin, t, trig::TableSize - 1);
+  c = lookup(tbl.cos, t, trig::TableSize - 1);
+}
+
+// Same as trig::turns(trig::toTurns(turns)): the 32-bit turn fraction is
+// carried as a whole number in double lanes, where it is exact.
+inline void sincosTurns(const trig::Table& tbl, vd turns, vd& s, vd& c) {
+  vd t    = floor(mul(sub(turns, floor(turns)), set1(trig::TurnScale)));
+  vd i    = floor(mul(t, set1(1. / static_cast<double>(1u << trig::TurnShift))));
+  vd d    = mul(fnmadd(i, set1(static_cast<double>(1u << trig::TurnShift)), t), 
+                set1(trig::RadiansPerTurnStep));
+  vd d2   = mul(d, d);
+  vd sd   = fnmadd(mul(d, d2), set1(1. / 6.), d);
+  vd cd   = fnmadd(d2, fnmadd(d2, set1(1. / 24.), set1(0.5)), set1(1.));
+
+  vd key  = add(i, set1(trig::RoundMagic));
+  vd ts   = lookup(tbl.sin, key, trig::TableSize - 1);
+  vd tc   = lookup(tbl.cos, key, trig::TableSize - 1);
+  s = fmadd(ts, cd, mul(tc, sd));
+  c = fnmadd(ts, sd, mul(tc, cd));
+}
+
+// sin/cos of 2 * pi * f for turn fractions f in [0, 1], in float lanes.
+// 4f - round(4f) is exact in float, so the only reduction error is the
+// rounding of f itself. Cephes sinf/cosf polynomials.
+inline void sincosTurnFraction(vf f, vf& s, vf& c) {
+  vf q  = round(mul(f, set1f(4.f)));
+  vf r  = mul(fnmadd(q, set1f(1.f), mul(f, set1f(4.f))), set1f(1.57079632679489661923f));
+  vf r2 = mul(r, r);
+
+  vf ps = set1f(-1.9515295891e-4f);
+  ps = fmadd(ps, r2, set1f(8.3321608736e-3f));
+  ps = fmadd(ps, r2, set1f(-1.6666654611e-1f));
+  s = fmadd(mul(r, r2), ps, r);
+
+  vf pc = set1f(2.443315711809948e-5f);
+  pc = fmadd(pc, r2, set1f(-1.388731625493765e-3f));
+  pc = fmadd(pc, r2, set1f(4.166664568298827e-2f));
+  c = fmadd(mul(r2, r2), pc, fnmadd(set1f(0.5f), r2, set1f(1.f)));
+
+  applyQuadrant(q, s, c);
+}
+
+#endif
+
+}  // namespace simd
+}  // namespace phys
+
+#endif /* ENGINE_SIMD_HPP */
@@ -0,0 +1,154 @@
+#include "superposition.hpp"
+#include "raw.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace phys {
+namespace superposition {
+
+namespace {
+
+using cplx = std::complex<double>;
+
+// Relative to the largest amplitude of the channel. Power edits give
+// factors exact to an ulp or two, and a field that was rescaled differs
+// from a fresh sum by rounding only.
+constexpr const double Tolerance = 1e-12;
+
+bool 
+samePoint(const Field& a, const Field& b, size_t i) {
+  return raw::same(a.xs()[i], b.xs()[i]) && raw::same(a.ys()[i], b.ys()[i]) && raw::same(a.zs()[i], b.zs()[i]);
+}
+
+double 
+largest(const Field& field, size_t ch, size_t& at) {
+  double norm = 0.;
+  at = 0;
+  for(size_t i = 0; i < field.size(); ++i) {
+    double len = std::hypot(field.re(ch)[i], field.im(ch)[i]);
+    if(len > norm) {
+      norm = len;
+      at = i;
+    }
+  }
+  return norm;
+}
+
+bool 
+sameAmplitudes(const Field& a, const Field& b, size_t i, const std::vector<double>& tolerance) {
+  for(size_t ch = 0; ch < a.channels(); ++ch) {
+    if(std::hypot(a.re(ch)[i] - b.re(ch)[i], a.im(ch)[i] - b.im(ch)[i]) > tolerance[ch]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// after = factor * before for every point of a channel, both on the same
+// points.
+bool 
+scaled(const Field& before, const Field& after, size_t ch, cplx& factor) {
+  const double* bre = before.re(ch);
+  const double* bim = before.im(ch);
+  const double* are = after.re(ch);
+  const double* aim = after.im(ch);
+
+  size_t at;
+  const double norm = largest(before, ch, at);
+  if(raw::same(norm, 0.)) {
+    factor = 1.;
+    for(size_t i = 0; i < after.size(); ++i) {
+      if(!raw::same(are[i], 0.) || !raw::same(aim[i], 0.)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  factor = cplx{are[at], aim[at]} / cplx{bre[at], bim[at]};
+  const double tolerance = Tolerance * norm * std::max(std::abs(factor), 1.);
+  for(size_t i = 0; i < before.size(); ++i) {
+    cplx expected = factor * cplx{bre[i], bim[i]};
+    if(std::abs(expected - cplx{are[i], aim[i]}) > tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void 
+append(Field& to, const Field& from, size_t i, double sign) {
+  to.push(EWave{}, from.position(i));
+  for(size_t ch = 0; ch < from.channels(); ++ch) {
+    to.re(ch)[to.size() - 1] = sign * from.re(ch)[i];
+    to.im(ch)[to.size() - 1] = sign * from.im(ch)[i];
+  }
+}
+
+}  // namespace
+
+Difference 
+compare(const Field& before, const Field& after) {
+  Difference diff;
+  if(before.channels() != after.channels() || after.size() < before.size() || after.empty()) {
+    return diff;
+  }
+
+  std::vector<double> tolerance(before.channels());
+  for(size_t ch = 0; ch < before.channels(); ++ch) {
+    size_t at;
+    tolerance[ch] = Tolerance * largest(before, ch, at);
+  }
+
+  std::vector<size_t> changed;
+  bool moved = after.size() != before.size();
+  for(size_t i = 0; i < before.size(); ++i) {
+    const bool point = samePoint(before, after, i);
+    moved |= !point;
+    if(!point || !sameAmplitudes(before, after, i, tolerance)) {
+      changed.push_back(i);
+    }
+  }
+  const size_t appended = after.size() - before.size();
+  if(changed.empty() && appended == 0) {
+    diff.kind = Difference::Kind::Same;
+    return diff;
+  }
+
+  if(!moved) {
+    diff.factors.resize(after.channels());
+    bool all = true;
+    for(size_t ch = 0; ch < after.channels() && all; ++ch) {
+      all = scaled(before, after, ch, diff.factors[ch]);
+    }
+    if(all) {
+      diff.kind = Difference::Kind::Scaled;
+      return diff;
+    }
+    diff.factors.clear();
+  }
+
+  if(2 * (2 * changed.size() + appended) >= after.size()) {
+    return diff;
+  }
+
+  diff.change.setChannels(after.channels());
+  diff.change.reserve(2 * changed.size() + appended);
+  for(size_t i : changed) {
+    append(diff.change, before, i, -1.);
+    append(diff.change, after, i, 1.);
+  }
+  for(size_t i = before.size(); i < after.size(); ++i) {
+    append(diff.change, after, i, 1.);
+  }
+  diff.kind = Difference::Kind::Points;
+  return diff;
+}
+
+size_t 
+footprint(const Field& field) {
+  return field.size() * (3 + 2 * field.channels()) * sizeof(double);
+}
+
+}  // namespace superposition
+}  // namespace phys
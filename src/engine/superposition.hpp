@@ -0,0 +1,43 @@
+#ifndef ENGINE_SUPERPOSITION_HPP
+#define ENGINE_SUPERPOSITION_HPP
+
+#include "field.hpp"
+#include <complex>
+#include <vector>
+
+// Propagation is linear in the source amplitudes: a field computed from
+// src follows a change of src without summing it again. If every
+// amplitude of a channel was multiplied by one factor, so is the field;
+// if a few points moved, appeared or changed amplitude, the field changes
+// by the contributions of those points only.
+
+namespace phys {
+namespace superposition {
+
+struct Difference {
+  enum class Kind {
+    Same,    // nothing changed
+    Scaled,  // same points, amplitudes of channel c times factors[c]
+    Points,  // a few points changed, the rest is the same
+    Other,   // sum it again
+  };
+
+  Kind kind = Kind::Other;
+  std::vector<std::complex<double>> factors{};
+  // Points: the changed points as they were, with negated amplitudes, and
+  // as they are. Its field is the change of the field computed from after.
+  Field change{};
+};
+
+// How after differs from before. Points is only reported while change
+// has fewer points than a half of after; beyond that a full sum is about
+// as cheap.
+Difference compare(const Field& before, const Field& after);
+
+// Bytes a copy of field takes.
+size_t footprint(const Field& field);
+
+}  // namespace superposition
+}  // namespace phys
+
+#endif /* ENGINE_SUPERPOSITION_HPP */
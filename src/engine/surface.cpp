@@ -1,20 +1,202 @@
 #include "surface.hpp"
+#include "convolution.hpp"
+#include "farfield.hpp"
+#include "fresnel.hpp"
+#include "kernels.hpp"
+#include "lookup.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <utility>
 
 namespace phys {
 
+namespace {
+
+// Fresnel methods need two grids and a phase error within tolerance at the
+// shortest wavelength; the check uses the bounds of both grids. The error
+// of a hop that does not fit goes to *phaseError.
+bool
+fresnelFits(const Field& src, const GridLayout& to, double z, const kernels::Medium& medium, double tolerance, 
+            double* phaseError) {
+  if(!fresnel::applicable(src, to, z)) {
+    return false;
+  }
+
+  const double lambda = *std::min_element(medium.lambda, medium.lambda + medium.channels);
+  const double error  = fresnel::phaseError(src, to, z, lambda);
+  if(error > tolerance) {
+    if(phaseError != nullptr) {
+      *phaseError = error;
+    }
+    return false;
+  }
+  return true;
+}
+
+// Whether config.method takes a hop onto the cells of `to` at z, rather
+// than leaving it to the direct sum.
+bool
+applies(const Field& src, const GridLayout& to, double z, const kernels::Medium& medium, 
+        const PropagationConfig& config, double* phaseError) {
+  switch(config.method) {
+    case Method::Fft:
+      return convolution::applicable(src, to, z);
+    case Method::Lookup:
+      return lookup::applicable(src, to, z);
+    case Method::ChirpZ:
+    case Method::Paraxial:
+      return fresnelFits(src, to, z, medium, config.fresnelTolerance, phaseError);
+    case Method::Tree:
+      return true;
+    case Method::Direct:
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
 Surface::~Surface() {}
 
 void 
-Surface::update(const std::vector<LightSource>&) {}
+Surface::publish() {
+  m_snapshot.store(getField());
+}
 
 void 
-Surface::recalculate(const std::vector<LightSource>& src, std::vector<LightSource>& dst, WavyEnvironment env) {
-  for(auto& [wave, pos] : dst) {
-    wave.clear();
-    for(const auto& [light, start] : src) {
-      wave += light.traveled((start - pos).Len(), env);
+Surface::update(const Field&) {}
+
+void 
+Surface::rescale(const std::vector<std::complex<double>>& factors) {
+  Field& dst = field();
+  for(size_t ch = 0; ch < dst.channels(); ++ch) {
+    const std::complex<double> k = factors[ch];
+    double* re = dst.re(ch);
+    double* im = dst.im(ch);
+    for(size_t i = 0; i < dst.size(); ++i) {
+      const double r = re[i];
+      re[i] = r * k.real() - im[i] * k.imag();
+      im[i] = r * k.imag() + im[i] * k.real();
+    }
+  }
+}
+
+bool 
+Surface::updateDelta(const Field& change) {
+  Field& dst = field();
+  Field part = dst;
+  propagate(change, part);
+  for(size_t ch = 0; ch < dst.channels(); ++ch) {
+    double* re = dst.re(ch);
+    double* im = dst.im(ch);
+    for(size_t i = 0; i < dst.size(); ++i) {
+      re[i] += part.re(ch)[i];
+      im[i] += part.im(ch)[i];
     }
   }
+  return true;
+}
+
+void
+Surface::propagate(const Field& src, Field& dst) {
+  double error = 0.;
+  recalculate(src, dst, m_envs, m_config, &error);
+  reportFallback(error);
+}
+
+bool
+Surface::methodFits(const Field& src, const GridLayout& to, LengthVal z) {
+  std::array<double, Field::MaxChannels> lambda;
+  for(size_t ch = 0; ch < m_envs.size(); ++ch) {
+    lambda[ch] = raw::wavelength(m_envs[ch]);
+  }
+  const kernels::Medium medium{raw::loss(m_envs.front()), lambda.data(), m_envs.size()};
+
+  double error = 0.;
+  const bool fits = applies(src, to, raw::value(z), medium, m_config, &error);
+  reportFallback(error);
+  return fits;
+}
+
+void
+Surface::reportFallback(double error) {
+  if(error > 0. && !m_fallbackReported) {
+    std::cerr << "Hop breaks the paraxial condition (phase error " << error << " rad, tolerance "
+              << m_config.fresnelTolerance << "), summing it directly\n";
+    m_fallbackReported = true;
+  }
+}
+
+void 
+Surface::recalculate(const Field& src, Field& dst, const std::vector<WavyEnvironment>& envs, 
+                     const PropagationConfig& config, double* phaseError) {
+  if(src.channels() != envs.size() || dst.channels() != envs.size()) {
+    std::cerr << "Channel count differs between fields and environments\n";
+    abort();
+  }
+
+  std::array<double,  Field::MaxChannels> lambda;
+  std::array<double*, Field::MaxChannels> re;
+  std::array<double*, Field::MaxChannels> im;
+  for(size_t ch = 0; ch < envs.size(); ++ch) {
+    lambda[ch] = raw::wavelength(envs[ch]);
+    re[ch] = dst.re(ch);
+    im[ch] = dst.im(ch);
+  }
+
+  // Channels differ only in wavelength, the loss is shared.
+  const kernels::Medium medium{raw::loss(envs.front()), lambda.data(), envs.size()};
+  const bool fits = config.method == Method::Tree || 
+                    (dst.grid() != nullptr && applies(src, *dst.grid(), dst.zs()[0], medium, config, phaseError));
+  if(fits) {
+    switch(config.method) {
+      case Method::Fft:
+        convolution::propagate(src, dst, medium);
+        return;
+      case Method::Lookup:
+        lookup::propagate(src, dst, medium);
+        return;
+      case Method::ChirpZ:
+        fresnel::chirpz(src, dst, medium);
+        return;
+      case Method::Paraxial:
+        fresnel::separable(src, dst, medium);
+        return;
+      case Method::Tree:
+        farfield::propagate(src, dst, medium, config.treeTolerance);
+        return;
+      case Method::Direct:
+      default:
+        break;
+    }
+  }
+
+  const kernels::Targets targets{dst.xs(), dst.ys(), dst.zs(), re.data(), im.data()};
+
+  // Every destination point is summed by exactly one task in source order,
+  // so the result does not depend on the thread count.
+  auto run = [&](const auto& from) {
+    size_t grain = parallel::MinPairsPerTask / std::max<size_t>(from.size(), 1);
+    parallel::forRanges(dst.size(), grain, [&](size_t begin, size_t end) {
+      switch(config.kernel) {
+        case Kernel::Simd:
+          kernels::simd(from, targets, begin, end, medium, config);
+          break;
+        case Kernel::Scalar:
+        default:
+          kernels::scalar(from, targets, begin, end, medium, config);
+          break;
+      }
+    });
+  };
+
+  if(config.precision == Precision::Mixed) {
+    // O(N) narrowing copy; it is streamed dst.size() times.
+    run(FieldF(src));
+  } else {
+    run(src);
+  }
 }
 
 
@@ -33,34 +215,50 @@ PointsBarrier::~PointsBarrier() {}
 void 
 PointsBarrier::addHole(Position hole) {
   if (!m_sources.empty()) {
-    if (hole.Z() != m_sources.front().second.Z()) {
+    if (hole.Z() != m_sources.position(0).Z()) {
       std::cerr << "You should add holes only with same Z coord\n";
       abort();
     }
   }
 
-  m_sources.emplace_back(EWave{}, std::move(hole));
-  updateRect();
+  m_bounds.extend(raw::point(hole));
+  m_sources.push(EWave{}, hole);
+  touch();
+}
+
+void 
+PointsBarrier::addHoles(const double* x, const double* y, const double* z, size_t n) {
+  if(n == 0) {
+    return;
+  }
+  const double z0 = m_sources.empty() ? z[0] : raw::value(m_sources.position(0).Z());
+  for(size_t k = 0; k < n; ++k) {
+    if(!raw::same(z[k], z0)) {
+      std::cerr << "You should add holes only with same Z coord\n";
+      abort();
+    }
+    m_bounds.extend(x[k], y[k], z[k]);
+  }
+
+  m_sources.append(x, y, z, n);
+  touch();
 }
 
 void 
 PointsBarrier::setHolePos(size_t i, Position hole) {
-  m_sources[i].second = hole;
+  m_sources.setPosition(i, hole);
   updateRect();
+  touch();
 }
 
 void 
-PointsBarrier::update(const std::vector<LightSource>& src) {
-  recalculate(src, m_sources, m_env);
+PointsBarrier::update(const Field& src) {
+  propagate(src, m_sources);
 }
 
 void
 PointsBarrier::updateRect() {
-  m_rect = {m_sources[0].second, m_sources[0].second};
-  for(auto [_, pos] : m_sources) {
-    m_rect.first  = std::min(m_rect.first,  pos);
-    m_rect.second = std::max(m_rect.second, pos);
-  }
+  m_bounds = raw::bounds(m_sources);
 }
 
 
@@ -70,8 +268,8 @@ PointsBarrier::updateRect() {
 
 
 void 
-ContigSurface::update(const std::vector<LightSource>& srcs) {
-  recalculate(srcs, m_srcs, m_env);  
+ContigSurface::update(const Field& srcs) {
+  propagate(srcs, m_srcs);
 }
 
 
@@ -86,24 +284,111 @@ ContigSurface::ContigSurface(Position pos, std::function<Position(Position)> tra
     genSurface();
 }
 
+void 
+ContigSurface::setZ(LengthVal z) {
+  if(dependsOnZ()) {
+    m_corner.Z() = z;
+    genSurface();
+    return;
+  }
+
+  const LengthVal dz = z - m_corner.Z();
+  m_corner.Z() = z;
+  m_srcs.shiftZ(dz);
+  m_rect.first.Z() += dz;
+  m_rect.second.Z() += dz;
+  touch();
+}
+
+bool
+ContigSurface::dependsOnZ() const {
+  return m_isTransparent || m_transformation;
+}
+
+void 
+ContigSurface::shape(Row& row) const {
+  if(!m_isTransparent && !m_transformation) {
+    return;
+  }
+
+  for(size_t k = 0; k < row.n; ++k) {
+    Position pos{LengthVal{row.x[k]}, LengthVal{row.y[k]}, LengthVal{row.z[k]}};
+    if(m_isTransparent && !m_isTransparent(pos)) {
+      row.keep[k] = 0;
+      continue;
+    }
+    if(m_transformation) {
+      pos = m_transformation(pos);
+      row.x[k] = raw::value(pos.X());
+      row.y[k] = raw::value(pos.Y());
+      row.z[k] = raw::value(pos.Z());
+    }
+  }
+}
+
 void 
 ContigSurface::genSurface() {
-  m_rect = {m_corner, m_corner};
+  touch();
   m_srcs.clear();
+  m_srcs.reserve(m_resolution * m_resolution);
+
+  const double x0 = raw::value(m_origin.X());
+  const double y0 = raw::value(m_origin.Y());
+  const double width  = raw::value(m_corner.X() - m_origin.X());
+  const double height = raw::value(m_corner.Y() - m_origin.Y());
+  const double z = raw::value(m_corner.Z());
+
+  std::vector<double> ys(m_resolution);
+  for(size_t j = 0; j < m_resolution; ++j) {
+    ys[j] = y0 + height * (static_cast<double>(j) / static_cast<double>(m_resolution));
+  }
+
+  std::vector<double> rowX(m_resolution);
+  std::vector<double> rowY(m_resolution);
+  std::vector<double> rowZ(m_resolution);
+  std::vector<uint8_t> keep(m_resolution);
+  std::vector<uint32_t> cells;
+  // Every kept point is still in its grid place.
+  bool regular = true;
   for(size_t i = 0; i < m_resolution; ++i) {
+    const double x = x0 + width * (static_cast<double>(i) / static_cast<double>(m_resolution));
+    std::fill(rowX.begin(), rowX.end(), x);
+    std::copy(ys.begin(), ys.end(), rowY.begin());
+    std::fill(rowZ.begin(), rowZ.end(), z);
+    std::fill(keep.begin(), keep.end(), uint8_t{1});
+
+    Row row{m_resolution, rowX.data(), rowY.data(), rowZ.data(), keep.data()};
+    shape(row);
+
+    // Kept points move to the front of the row.
+    size_t kept = 0;
     for(size_t j = 0; j < m_resolution; ++j) {
-      num_t x = static_cast<double>(i) / static_cast<double>(m_resolution);
-      num_t y = static_cast<double>(j) / static_cast<double>(m_resolution);
-      Position pos = m_corner;
-      pos[0] *= x;
-      pos[1] *= y;
-      if(m_isTransparent(pos)) {
-        m_srcs.emplace_back(EWave{}, m_transformation(pos));
-        m_rect.first  = std::min(m_rect.first , m_srcs.back().second);
-        m_rect.second = std::max(m_rect.second, m_srcs.back().second);
+      if(keep[j]) {
+        regular = regular && raw::same(rowX[j], x) && raw::same(rowY[j], ys[j]) && raw::same(rowZ[j], z);
+        rowX[kept] = rowX[j];
+        rowY[kept] = rowY[j];
+        rowZ[kept] = rowZ[j];
+        cells.push_back(static_cast<uint32_t>(i * m_resolution + j));
+        ++kept;
       }
     }
+    m_srcs.append(rowX.data(), rowY.data(), rowZ.data(), kept);
   } 
+  m_rect = raw::bounds(m_srcs).rect();
+
+  // Points left in place are the cells of a square grid.
+  if(regular && !m_srcs.empty()) {
+    GridLayout grid;
+    grid.x0 = x0;
+    grid.y0 = y0;
+    grid.dx = width / static_cast<double>(m_resolution);
+    grid.dy = height / static_cast<double>(m_resolution);
+    grid.nx = grid.ny = m_resolution;
+    if(cells.size() != m_resolution * m_resolution) {
+      grid.cells = std::move(cells);
+    }
+    m_srcs.setGrid(std::move(grid));
+  }
 }
 
 }  // namespace phys
@@ -1,31 +1,133 @@
 #ifndef ENGINE_SURFACE_HPP
 #define ENGINE_SURFACE_HPP
+#include "field.hpp"
+#include "propagation.hpp"
+#include "raw.hpp"
 #include "units.hpp"
 #include "wave.hpp"
+#include <atomic>
+#include <complex>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <utility>
 
 namespace phys {
 
-using LightSource = std::pair<EWave, Position>;
+// Latest published copy of a value. A published copy never changes:
+// readers on any thread keep it as long as they like while the next one
+// is prepared, and neither side waits for the other.
+template <typename T>
+class Published {
+ public:
+  Published() = default;
+  // A copy starts with nothing published.
+  Published(const Published&) {}
+  Published& operator=(const Published&) {return *this;}
+
+  // Null before the first store().
+  std::shared_ptr<const T> 
+  load() const {
+    return m_current.load(std::memory_order_acquire);
+  }
+
+  // Only ever called from one thread at a time.
+  void 
+  store(const T& value) {
+    // Once unpublished a buffer only loses readers, so a spare nobody else
+    // holds stays free; one still read is left to its readers.
+    std::shared_ptr<T> next = std::move(m_spare);
+    if(next == nullptr || next.use_count() != 1) {
+      next = std::make_shared<T>();
+    }
+    // use_count() is a relaxed load. The last reader let go of the spare
+    // with a release decrement after its final read; the fence pairs with
+    // it, so those reads happen before the writes below.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    *next = value;
+    m_current.store(next, std::memory_order_release);
+    m_spare = std::exchange(m_front, std::move(next));
+  }
+
+  // Nothing published and no buffers kept; readers keep what they hold.
+  // Same thread as store().
+  void 
+  clear() {
+    m_current.store(nullptr, std::memory_order_release);
+    m_front.reset();
+    m_spare.reset();
+  }
+
+ private:
+  // Double buffer: the published copy and the one before it, which the
+  // next store() writes again once no reader holds it.
+  std::atomic<std::shared_ptr<const T>> m_current{};
+  std::shared_ptr<T> m_front{};
+  std::shared_ptr<T> m_spare{};
+};
 
 class EWave;
 class Surface {
  public:
+  Surface() = default;
+  // A copy has the same field, but publishes snapshots of its own.
+  Surface(const Surface& other) = default;
+  Surface& operator=(const Surface& other) = default;
   virtual ~Surface();
 
-  virtual const std::vector<LightSource>& getSrcs() const = 0;
+  virtual const Field& getField() const = 0;
+
+  // Array-of-structures copy of getField(), kept for existing callers.
+  std::vector<LightSource> getSrcs() const {
+    return getField().sources();
+  }
+
+  virtual void update(const Field& src);
+
+  // Same as update() from a source that differs from the last one by
+  // superposition: every channel times a factor, or by the sources of
+  // change (see superposition::compare). Cost is O(points), or O(points)
+  // per source of change.
+  virtual void rescale(const std::vector<std::complex<double>>& factors);
 
-  virtual void update(const std::vector<LightSource>& srcs);
+  // False if the surface cannot follow a change point by point; the
+  // caller updates it from the whole source then.
+  virtual bool updateDelta(const Field& change);
 
   virtual std::pair<Position, Position> getRect() const = 0;
 
-  static void recalculate(const std::vector<LightSource>& src, std::vector<LightSource>& dst, WavyEnvironment env);
+  // One environment per channel of dst. When a Fresnel method does not
+  // fit the hop and it is summed directly instead, *phaseError (if given)
+  // is set to the phase error that ruled the method out.
+  static void recalculate(const Field& src, Field& dst, const std::vector<WavyEnvironment>& envs, 
+                          const PropagationConfig& config = {}, double* phaseError = nullptr);
 
   [[deprecated("Use update")]] virtual bool setParent(Surface* ) {return true;}
 
-  virtual void 
+  void 
   setEnvironment(WavyEnvironment env) {
-    m_env = env;
+    setEnvironments({env});
+  }
+
+  // One environment per wavelength; the field gets a channel for each.
+  virtual void 
+  setEnvironments(std::vector<WavyEnvironment> envs) {
+    field().setChannels(envs.size());
+    m_envs = std::move(envs);
+    touch();
+  }
+
+  size_t channels() const {
+    return getField().channels();
+  }
+
+  virtual void 
+  setPropagation(const PropagationConfig& config) {
+    if(config.method != m_config.method || !raw::same(config.fresnelTolerance, m_config.fresnelTolerance)) {
+      m_fallbackReported = false;
+    }
+    m_config = config;
+    touch();
   }
 
   LengthVal getZ() const {
@@ -35,61 +137,140 @@ class Surface {
 
   virtual void setZ(LengthVal z) = 0;
 
+  // Moves on with every change of the points, the amplitudes the surface
+  // emits by itself, its environments or its configuration, but not when
+  // update() recomputes the field. Chamber recomputes from the first
+  // surface whose revision moved.
+  uint64_t revision() const {return m_revision;}
+
+  // The field as the last publish() left it, null before the first one;
+  // see Published. getField() is only for the updating thread.
+  std::shared_ptr<const Field> 
+  snapshot() const {
+    return m_snapshot.load();
+  }
+
+  // Makes the current field the snapshot. Called between updates, on the
+  // thread that runs them; Chamber does it after every hop it finished.
+  virtual void publish();
+
+  // Drops the snapshot and the buffers behind it, snapshot() is null until
+  // the next publish(). Same thread as publish().
+  void 
+  unpublish() {
+    m_snapshot.clear();
+  }
+
+  // Points of the surface as a field, for fields evaluated on its places
+  // (Chamber::sweep). Only positions and the grid are meaningful.
+  virtual Field 
+  points() const {
+    return getField();
+  }
+
 protected:
-  WavyEnvironment m_env;
+  virtual Field& field() = 0;
+
+  void touch() {++m_revision;}
+
+  // recalculate() with the surface's environments and configuration. A
+  // hop the Fresnel method does not fit is reported once, not on every
+  // update, until the method or its tolerance changes.
+  void propagate(const Field& src, Field& dst);
+
+  // Whether propagate() onto every cell of `to` in the plane z would run
+  // the configured method instead of the direct sum. A Fresnel hop that
+  // does not fit is reported as propagate() reports it.
+  bool methodFits(const Field& src, const GridLayout& to, LengthVal z);
+
+  std::vector<WavyEnvironment> m_envs{WavyEnvironment{}};
+  PropagationConfig m_config{};
+
+private:
+  void reportFallback(double phaseError);
+
+  uint64_t m_revision = 0;
+  bool m_fallbackReported = false;
+
+  Published<Field> m_snapshot{};
 };
 
 //====================================================================================/
 //================================< Point Lights >====================================/
 //====================================================================================/
 
-class PointLights : public Surface {
+class PointLights final : public Surface {
  public:
   void 
   addSource(LightSource source) {
     if (!m_sources.empty()) {
-      if (source.second.Z() != m_sources.front().second.Z()) {
+      if (source.second.Z() != m_sources.position(0).Z()) {
         std::cerr << "You should add sources only with same Z coord\n";
         abort();
       }
     }
 
-    m_rect.first  = std::min(m_rect.first,  source.second);
-    m_rect.second = std::max(m_rect.second, source.second);
-    m_sources.push_back(std::move(source));
+    m_bounds.extend(raw::point(source.second));
+    m_sources.push(source.first, source.second);
+    touch();
   }
 
   virtual void setZ(LengthVal z) override {
-    for(auto& [_,pos] : m_sources) {
-      pos.Z() = z;
-    }
-    m_rect.first.Z() = m_rect.second.Z() = z;
+    m_sources.setZ(z);
+    m_bounds.lo.z = m_bounds.hi.z = raw::value(z);
+    touch();
   }
 
   void
   setPower(EFieldVal val) {
-    for(auto& p : m_sources){
-      p.first = EWave(val);
+    for(size_t ch = 0; ch < m_sources.channels(); ++ch) {
+      setPower(ch, val);
     }
   }
 
-  virtual const std::vector<LightSource>& 
-  getSrcs() const override {
+  // Power of one wavelength only, adds channels up to it if needed.
+  // Setting the power a channel already has is not a change.
+  void
+  setPower(size_t channel, EFieldVal val) {
+    if(channel >= m_sources.channels()) {
+      m_sources.setChannels(channel + 1);
+      touch();
+    }
+    const EWave wave(val);
+    for(size_t i = 0; i < m_sources.size(); ++i){
+      if(!(m_sources.wave(i, channel).getComplex() == wave.getComplex())) {
+        m_sources.setWave(i, channel, wave);
+        touch();
+      }
+    }
+  }
+
+  virtual const Field& 
+  getField() const override {
     return m_sources;
   }
 
   virtual std::pair<Position, Position> 
-  getRect() const override {return m_rect;}
+  getRect() const override {return m_bounds.rect();}
 
   virtual void 
-  update(const std::vector<LightSource>&) override {}
+  update(const Field&) override {}
+
+  virtual void 
+  rescale(const std::vector<std::complex<double>>&) override {}
+
+  virtual bool 
+  updateDelta(const Field&) override {return true;}
 
   virtual ~PointLights() override;
 
+ protected:
+  virtual Field& field() override {return m_sources;}
+
  private:
-  std::vector<LightSource> m_sources;
-  std::pair<Position, Position> m_rect;
-  Frequency m_frequency;
+  Field m_sources{};
+  raw::Box m_bounds{};
+  Frequency m_frequency{};
 };
 
 
@@ -98,36 +279,41 @@ class PointLights : public Surface {
 //====================================================================================/
 
 
-class PointsBarrier : public Surface {
+class PointsBarrier final : public Surface {
  public:
   void addHole(Position hole);
 
+  // Holes (x[k], y[k], z[k]) for k < n in plain metres, all at the z of
+  // the others. For long lists read in batches.
+  void addHoles(const double* x, const double* y, const double* z, size_t n);
+
   void setHolePos(size_t i, Position hole);
 
-  virtual const std::vector<LightSource>& 
-  getSrcs() const override {return m_sources;}
+  virtual const Field& 
+  getField() const override {return m_sources;}
 
-  virtual void update(const std::vector<LightSource>&) override;
+  virtual void update(const Field& src) override;
 
   virtual std::pair<Position, Position> 
-  getRect() const override {return m_rect;}
+  getRect() const override {return m_bounds.rect();}
 
   virtual ~PointsBarrier() override;
 
   virtual void 
   setZ(LengthVal z) override {
-    for(auto& [_,pos] : m_sources) {
-      pos.Z() = z;
-    }
+    m_sources.setZ(z);
     updateRect();
+    touch();
   }
 
+ protected:
+  virtual Field& field() override {return m_sources;}
 
  private:
   void updateRect();
 
-  std::vector<LightSource> m_sources;
-  std::pair<Position, Position> m_rect;
+  Field m_sources{};
+  raw::Box m_bounds{};
 };
 
 //====================================================================================/
@@ -136,15 +322,27 @@ class PointsBarrier : public Surface {
 
 class ContigSurface : public Surface {
 public:
+  // One row of the grid in plain metres: points (x[k], y[k], z[k]) for
+  // k < n, all on the grid and at the z of the surface when shape() gets
+  // them. A shape clears keep[k] of the points it blocks and may move
+  // any point; points left in their grid places keep the field a grid.
+  struct Row {
+    size_t n;
+    double* x;
+    double* y;
+    double* z;
+    uint8_t* keep;
+  };
+
   ContigSurface(Position pos);
   ContigSurface(Position pos, std::function<Position(Position)> transform  );
   ContigSurface(Position pos, std::function<bool    (Position)> transparent);
   ContigSurface(Position pos, std::function<Position(Position)> transform, std::function<bool (Position)> transparent);
 
-  virtual void update(const std::vector<LightSource>& src) override;
+  virtual void update(const Field& src) override;
   
-  virtual const std::vector<LightSource>& 
-  getSrcs() const override {return m_srcs;}
+  virtual const Field& 
+  getField() const override {return m_srcs;}
 
   virtual std::pair<Position, Position> 
   getRect() const override {return m_rect;}
@@ -159,23 +357,72 @@ public:
     genSurface();
   }
 
-  virtual void 
-  setZ(LengthVal z) override {
-    m_corner.Z() = z;
+  // Samples the rectangle from `from` to `to` (exclusive) instead of the one
+  // from the axis origin; z is taken from `to`.
+  void setWindow(Position from, Position to) {
+    m_origin = from;
+    m_corner = to;
     genSurface();
   }
 
+  // Moves the points as they are. Only a shape that depends on z gets
+  // the surface generated again.
+  virtual void setZ(LengthVal z) override;
+
+protected:
+  virtual Field& field() override {return m_srcs;}
+
+  // Masks and moves the points of one row. Without per-point functions it
+  // keeps the grid as it is.
+  virtual void shape(Row& row) const;
+
+  // Whether shape() looks at the z of the points. Per-point functions
+  // may, so they count as depending on it.
+  virtual bool dependsOnZ() const;
+
+  void genSurface();
 
 private:
-  Position m_corner;
-  std::function<bool    (Position)> m_isTransparent  = [](Position){return true;};
-  std::function<Position(Position)> m_transformation = [](Position p){return p;};
+  Position m_origin{};
+  Position m_corner{};
+  std::function<bool    (Position)> m_isTransparent{};
+  std::function<Position(Position)> m_transformation{};
 
   size_t m_resolution = 1;
-  void genSurface();
 
-  std::pair<Position, Position> m_rect;
-  std::vector<LightSource> m_srcs;
+  std::pair<Position, Position> m_rect{};
+  Field m_srcs{};
+};
+
+// ContigSurface whose mask and transformation are one callable known at
+// compile time, called as shape(row) once per row on plain doubles, so it
+// inlines into its own loop and vectorizes. setZ moves the generated
+// points without shaping them again, unless the shape has a member
+// dependsOnZ() that says it reads the z of the row.
+template <typename Shape>
+class ShapedSurface : public ContigSurface {
+public:
+  ShapedSurface(Position pos, Shape shape) : ContigSurface(pos), m_shape(std::move(shape)) {
+    genSurface();
+  }
+
+protected:
+  virtual void 
+  shape(Row& row) const override {
+    m_shape(row);
+  }
+
+  virtual bool
+  dependsOnZ() const override {
+    if constexpr (requires {m_shape.dependsOnZ();}) {
+      return m_shape.dependsOnZ();
+    } else {
+      return false;
+    }
+  }
+
+private:
+  Shape m_shape;
 };
 
 
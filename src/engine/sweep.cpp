@@ -0,0 +1,95 @@
+#include "sweep.hpp"
+#include "kernels.hpp"
+#include "parallel.hpp"
+#include "raw.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace phys {
+namespace sweep {
+
+namespace {
+
+// Sums src into the lateral points x, y of every plane of zs; re and im
+// hold a stream per plane and channel, plane-major.
+void 
+evaluate(const Field& src, const double* x, const double* y, size_t points,
+         const std::vector<double>& zs, const std::vector<double*>& re,
+         const std::vector<double*>& im, const std::vector<WavyEnvironment>& envs,
+         const PropagationConfig& config) {
+  if(src.channels() != envs.size()) {
+    std::cerr << "Channel count differs between the field and environments\n";
+    abort();
+  }
+
+  std::vector<double> lambda(envs.size());
+  for(size_t ch = 0; ch < envs.size(); ++ch) {
+    lambda[ch] = raw::wavelength(envs[ch]);
+  }
+  const kernels::Medium medium{raw::loss(envs.front()), lambda.data(), envs.size()};
+  const kernels::Stack stack{x, y, zs.data(), zs.size(), re.data(), im.data()};
+
+  const size_t grain = parallel::MinPairsPerTask / std::max<size_t>(src.size() * zs.size(), 1);
+  parallel::forRanges(points, grain, [&](size_t begin, size_t end) {
+    kernels::stack(src, stack, begin, end, medium, config);
+  });
+}
+
+}  // namespace
+
+std::vector<Field> 
+planes(const Field& src, const Field& plane, const std::vector<LengthVal>& zs,
+       const std::vector<WavyEnvironment>& envs, const PropagationConfig& config) {
+  std::vector<Field> out(zs.size(), plane);
+  std::vector<double> z(zs.size());
+  std::vector<double*> re;
+  std::vector<double*> im;
+  for(size_t k = 0; k < zs.size(); ++k) {
+    z[k] = raw::value(zs[k]);
+    out[k].setZ(zs[k]);
+    out[k].setChannels(envs.size());
+    for(size_t ch = 0; ch < envs.size(); ++ch) {
+      re.push_back(out[k].re(ch));
+      im.push_back(out[k].im(ch));
+    }
+  }
+
+  evaluate(src, plane.xs(), plane.ys(), plane.size(), z, re, im, envs, config);
+  return out;
+}
+
+Field 
+slice(const Field& src, Position from, Position to, size_t nx, size_t nz,
+      const std::vector<WavyEnvironment>& envs, const PropagationConfig& config) {
+  const double x0 = raw::value(from.X());
+  const double dx = (raw::value(to.X()) - x0) / static_cast<double>(nx);
+  const double z1 = raw::value(to.Z());
+  const double dz = nz > 1 ? (z1 - raw::value(from.Z())) / static_cast<double>(nz - 1) : 0.;
+
+  Field out;
+  out.setChannels(envs.size());
+  out.reserve(nx * nz);
+  std::vector<double> z(nz);
+  for(size_t k = 0; k < nz; ++k) {
+    z[k] = z1 - dz * static_cast<double>(nz - 1 - k);
+    for(size_t i = 0; i < nx; ++i) {
+      out.push(EWave{}, Position{LengthVal{x0 + dx * static_cast<double>(i)}, from.Y(), LengthVal{z[k]}});
+    }
+  }
+
+  // Every plane holds the same lateral points, those of plane 0.
+  std::vector<double*> re;
+  std::vector<double*> im;
+  for(size_t k = 0; k < nz; ++k) {
+    for(size_t ch = 0; ch < envs.size(); ++ch) {
+      re.push_back(out.re(ch) + k * nx);
+      im.push_back(out.im(ch) + k * nx);
+    }
+  }
+
+  evaluate(src, out.xs(), out.ys(), nx, z, re, im, envs, config);
+  return out;
+}
+
+}  // namespace sweep
+}  // namespace phys
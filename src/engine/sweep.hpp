@@ -0,0 +1,35 @@
+#ifndef ENGINE_SWEEP_HPP
+#define ENGINE_SWEEP_HPP
+
+#include "field.hpp"
+#include "propagation.hpp"
+#include "units.hpp"
+#include "wave.hpp"
+#include <vector>
+
+// One source field evaluated on many parallel planes at once. With
+// r^2 = (dx^2 + dy^2) + dz^2 the lateral part of a pair is the same on
+// every plane, so the batched kernel computes it and loads the sources
+// once per block of planes instead of once per plane. Every plane is
+// summed directly, as Method::Direct would.
+
+namespace phys {
+namespace sweep {
+
+// Field of src on the points of `plane` moved to each z of zs, one field
+// per z in that order. One environment per channel, as in
+// Surface::recalculate.
+std::vector<Field> planes(const Field& src, const Field& plane, const std::vector<LengthVal>& zs,
+                          const std::vector<WavyEnvironment>& envs,
+                          const PropagationConfig& config = {});
+
+// Side view: src on nx points from `from` towards `to` along x (the last
+// one excluded), at the y of `from`, on nz planes from the z of `from` to
+// the z of `to` (both included). Point k * nx + i is point i of plane k.
+Field slice(const Field& src, Position from, Position to, size_t nx, size_t nz,
+            const std::vector<WavyEnvironment>& envs, const PropagationConfig& config = {});
+
+}  // namespace sweep
+}  // namespace phys
+
+#endif /* ENGINE_SWEEP_HPP */
@@ -0,0 +1,282 @@
+#include "tonemap.hpp"
+#include "parallel.hpp"
+#include "raw.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <mutex>
+
+namespace phys {
+namespace tonemap {
+
+namespace {
+
+constexpr const size_t MinPointsPerTask = 1 << 15;
+
+// Values below Black are black: 2^-24, seven decades under white.
+constexpr const float Black = 0x1p-24f;
+constexpr const int BlackBits = std::bit_cast<int>(Black);
+constexpr const int WhiteBits = std::bit_cast<int>(1.f);
+
+// The curve is tabulated on 8 bits of mantissa, a step of 0.4%, or at most
+// one level at white.
+constexpr const int LevelShift = 23 - 8;
+constexpr const size_t Levels = ((WhiteBits - BlackBits) >> LevelShift) + 1;
+
+double
+level(const Curve& curve, double value) {
+  double t = value;
+  if(curve.log) {
+    t = std::clamp(1. + std::log10(value) / curve.decades, 0., 1.);
+  }
+  if(!raw::same(curve.gamma, 1.)) {
+    t = std::pow(t, 1. / curve.gamma);
+  }
+  return t;
+}
+
+inline uint32_t
+lookup(const int* levels, float value) {
+  // max first: a NaN becomes black.
+  value = std::min(std::max(Black, value), 1.f);
+  return static_cast<uint32_t>(levels[(std::bit_cast<int>(value) - BlackBits) >> LevelShift]);
+}
+
+inline size_t
+bin(float value) {
+  return (std::bit_cast<uint32_t>(value) >> 22) & (Stats::Bins - 1);
+}
+
+}  // namespace
+
+//===< Colours >===/
+
+Rgb
+spectral(LengthVal wavelength) {
+  // After D. Bruton, piecewise linear over the visible range and dimmed
+  // towards both of its ends.
+  const double nm = raw::value(wavelength) * 1e9;
+  double r = 0., g = 0., b = 0.;
+  if(nm >= 380. && nm < 440.) {
+    r = (440. - nm) / 60.;
+    b = 1.;
+  } else if(nm >= 440. && nm < 490.) {
+    g = (nm - 440.) / 50.;
+    b = 1.;
+  } else if(nm >= 490. && nm < 510.) {
+    g = 1.;
+    b = (510. - nm) / 20.;
+  } else if(nm >= 510. && nm < 580.) {
+    r = (nm - 510.) / 70.;
+    g = 1.;
+  } else if(nm >= 580. && nm < 645.) {
+    r = 1.;
+    g = (645. - nm) / 65.;
+  } else if(nm >= 645. && nm <= 780.) {
+    r = 1.;
+  }
+
+  double factor = 1.;
+  if(nm < 420.) {
+    factor = 0.3 + 0.7 * (nm - 380.) / 40.;
+  } else if(nm > 700.) {
+    factor = 0.3 + 0.7 * (780. - nm) / 80.;
+  }
+  return {static_cast<float>(r * factor), static_cast<float>(g * factor), static_cast<float>(b * factor)};
+}
+
+//===< Accumulation >===/
+
+void
+Hdr::resize(size_t n) {
+  points = n;
+  r.resize(n);
+  g.resize(n);
+  b.resize(n);
+}
+
+namespace {
+
+// |E|^2 of a field, computed from its amplitudes.
+struct Amplitudes {
+  const Field& field;
+
+#if PHYS_SIMD_WIDTH > 1
+  simd::vf
+  vector(size_t ch, size_t i) const {
+    const double* re = field.re(ch) + i;
+    const double* im = field.im(ch) + i;
+    simd::vd lo = simd::load(re);
+    simd::vd hi = simd::load(re + simd::Width);
+    lo = simd::mul(lo, lo);
+    hi = simd::mul(hi, hi);
+    simd::vd loIm = simd::load(im);
+    simd::vd hiIm = simd::load(im + simd::Width);
+    return simd::toFloat(simd::fmadd(loIm, loIm, lo), simd::fmadd(hiIm, hiIm, hi));
+  }
+#endif
+
+  float
+  scalar(size_t ch, size_t i) const {
+    const double re = field.re(ch)[i];
+    const double im = field.im(ch)[i];
+    return static_cast<float>(re * re + im * im);
+  }
+};
+
+// |E|^2 as a Screen stored it.
+struct Stored {
+  const Intensity& intensity;
+
+#if PHYS_SIMD_WIDTH > 1
+  simd::vf
+  vector(size_t ch, size_t i) const {
+    return simd::load(intensity.channel(ch) + i);
+  }
+#endif
+
+  float
+  scalar(size_t ch, size_t i) const {
+    return intensity.channel(ch)[i];
+  }
+};
+
+template <typename Source>
+Stats
+mix(const Source& source, size_t points, size_t channels, const std::vector<Rgb>& colors, Hdr& hdr) {
+  hdr.resize(points);
+  channels = std::min(channels, colors.size());
+  float* r = hdr.r.data();
+  float* g = hdr.g.data();
+  float* b = hdr.b.data();
+
+  Stats stats;
+  stats.points = points;
+  std::mutex mutex;
+
+  parallel::forRanges(points, MinPointsPerTask, [&](size_t begin, size_t end) {
+    std::array<size_t, Stats::Bins> histogram{};
+    float max = 0.f;
+    auto count = [&](float value) {
+      max = std::max(max, value);
+      ++histogram[bin(value)];
+    };
+
+    size_t i = begin;
+#if PHYS_SIMD_WIDTH > 1
+    // Sums stay in registers over all channels, the planes are written
+    // once and the statistics come without reading them back.
+    alignas(64) float peaks[simd::WidthF];
+    for(; i + simd::WidthF <= end; i += simd::WidthF) {
+      simd::vf vr = simd::zerof();
+      simd::vf vg = simd::zerof();
+      simd::vf vb = simd::zerof();
+      for(size_t ch = 0; ch < channels; ++ch) {
+        const simd::vf intensity = source.vector(ch, i);
+        vr = simd::fmadd(intensity, simd::set1f(colors[ch].r), vr);
+        vg = simd::fmadd(intensity, simd::set1f(colors[ch].g), vg);
+        vb = simd::fmadd(intensity, simd::set1f(colors[ch].b), vb);
+      }
+      simd::store(r + i, vr);
+      simd::store(g + i, vg);
+      simd::store(b + i, vb);
+
+      simd::store(peaks, simd::max(simd::max(vr, vg), vb));
+      for(float peak : peaks) {
+        count(peak);
+      }
+    }
+#endif
+    for(; i < end; ++i) {
+      float sr = 0.f, sg = 0.f, sb = 0.f;
+      for(size_t ch = 0; ch < channels; ++ch) {
+        const float intensity = source.scalar(ch, i);
+        sr += intensity * colors[ch].r;
+        sg += intensity * colors[ch].g;
+        sb += intensity * colors[ch].b;
+      }
+      r[i] = sr;
+      g[i] = sg;
+      b[i] = sb;
+      count(std::max({sr, sg, sb}));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.max = std::max(stats.max, max);
+    for(size_t k = 0; k < Stats::Bins; ++k) {
+      stats.histogram[k] += histogram[k];
+    }
+  });
+  return stats;
+}
+
+}  // namespace
+
+Stats
+accumulate(const Field& field, const std::vector<Rgb>& colors, Hdr& hdr) {
+  return mix(Amplitudes{field}, field.size(), field.channels(), colors, hdr);
+}
+
+Stats
+accumulate(const Intensity& intensity, const std::vector<Rgb>& colors, Hdr& hdr) {
+  return mix(Stored{intensity}, intensity.points(), intensity.channels, colors, hdr);
+}
+
+//===< Exposure >===/
+
+float
+Stats::percentile(double fraction) const {
+  const size_t target = static_cast<size_t>(std::ceil(std::clamp(fraction, 0., 1.) * static_cast<double>(points)));
+  size_t seen = 0;
+  for(size_t k = 0; k + 1 < Bins; ++k) {
+    seen += histogram[k];
+    if(seen >= target) {
+      return std::min(std::bit_cast<float>(static_cast<uint32_t>((k + 1) << 22)), max);
+    }
+  }
+  return max;
+}
+
+//===< Mapping >===/
+
+ToneMap::ToneMap(const Curve& curve)
+  : m_curve(curve), m_levels(Levels) {
+  for(size_t k = 0; k < Levels; ++k) {
+    // The middle of the values that share the entry; white is exact.
+    const int bits = BlackBits + static_cast<int>(k << LevelShift) + (1 << (LevelShift - 1));
+    const double value = k + 1 == Levels ? 1. : std::bit_cast<float>(bits);
+    m_levels[k] = static_cast<int>(std::lround(255. * std::clamp(level(m_curve, value), 0., 1.)));
+  }
+}
+
+void
+ToneMap::apply(const Hdr& hdr, float scale, uint32_t* argb) const {
+  const int* levels = m_levels.data();
+  const float* r = hdr.r.data();
+  const float* g = hdr.g.data();
+  const float* b = hdr.b.data();
+
+  parallel::forRanges(hdr.points, MinPointsPerTask, [&](size_t begin, size_t end) {
+    size_t i = begin;
+#if PHYS_SIMD_WIDTH > 1
+    const simd::vf factor = simd::set1f(scale);
+    const simd::vf black = simd::set1f(Black);
+    const simd::vf white = simd::set1f(1.f);
+    auto levelsOf = [&](const float* p) {
+      simd::vf v = simd::min(simd::max(simd::mul(simd::load(p), factor), black), white);
+      return simd::lookupBits<LevelShift>(levels, v, BlackBits);
+    };
+    for(; i + simd::WidthF <= end; i += simd::WidthF) {
+      simd::storeRgb(argb + i, levelsOf(r + i), levelsOf(g + i), levelsOf(b + i));
+    }
+#endif
+    for(; i < end; ++i) {
+      argb[i] = 0xff000000u | lookup(levels, r[i] * scale) << 16 | lookup(levels, g[i] * scale) << 8 |
+                lookup(levels, b[i] * scale);
+    }
+  });
+}
+
+}  // namespace tonemap
+}  // namespace phys
@@ -0,0 +1,88 @@
+#ifndef ENGINE_TONEMAP_HPP
+#define ENGINE_TONEMAP_HPP
+
+#include "field.hpp"
+#include "screen.hpp"
+#include "units.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// From a field to 8-bit pixels in three stages. accumulate sums the
+// intensity of every channel (wavelength), weighted by its colour, into a
+// float RGB buffer and reduces it to its maximum and a histogram, which
+// pick the white point. ToneMap scales by exposure / white and applies the
+// display curve. Pixels come out in point order.
+
+namespace phys {
+namespace tonemap {
+
+struct Rgb {
+  float r = 0.f;
+  float g = 0.f;
+  float b = 0.f;
+};
+
+// Colour of light of the given wavelength in vacuum, black outside
+// 380-780 nm. A spectral field painted with these looks the way it would.
+Rgb spectral(LengthVal wavelength);
+
+// Linear intensity, one plane per colour component.
+struct Hdr {
+  size_t points = 0;
+  AlignedVector<float> r{};
+  AlignedVector<float> g{};
+  AlignedVector<float> b{};
+
+  void resize(size_t n);
+};
+
+// Of the brightest component of every point.
+struct Stats {
+  // Half an octave per bin, over the whole float range.
+  static constexpr const size_t Bins = 512;
+
+  float max = 0.f;
+  size_t points = 0;
+  std::array<size_t, Bins> histogram{};
+
+  // Upper edge of the bin where the share fraction of the points, darkest
+  // first, ends. Overestimates by at most a factor of sqrt(2), and never
+  // exceeds max.
+  float percentile(double fraction) const;
+};
+
+// hdr = sum over channels ch of |E_ch|^2 * colors[ch]. Channels without a
+// colour are left out. The statistics of hdr are reduced on the way.
+Stats accumulate(const Field& field, const std::vector<Rgb>& colors, Hdr& hdr);
+
+// Same from the intensity a Screen recorded.
+Stats accumulate(const Intensity& intensity, const std::vector<Rgb>& colors, Hdr& hdr);
+
+struct Curve {
+  double gamma = 1.;     // level = value^(1 / gamma)
+  bool log = false;      // log10 scale, white at the top
+  double decades = 4.;   // of the log scale, below that is black
+};
+
+class ToneMap {
+ public:
+  explicit ToneMap(const Curve& curve = {});
+
+  const Curve& curve() const {return m_curve;}
+
+  // argb[i] = 0xffRRGGBB of point i, hdr values times scale mapped through
+  // the curve with 1 as white. argb holds hdr.points pixels.
+  void apply(const Hdr& hdr, float scale, uint32_t* argb) const;
+
+ private:
+  Curve m_curve;
+  // Levels of the curve, indexed by the top bits of a float in [Black, 1].
+  AlignedVector<int> m_levels;
+};
+
+}  // namespace tonemap
+}  // namespace phys
+
+#endif /* ENGINE_TONEMAP_HPP */
@@ -0,0 +1,21 @@
+#include "trig.hpp"
+
+namespace phys {
+namespace trig {
+
+const Table& 
+table() {
+  static const Table instance = [] {
+    Table tbl{};
+    for(size_t i = 0; i < TableSize; ++i) {
+      double phase = static_cast<double>(i) / TableScale;
+      tbl.sin[i] = std::sin(phase);
+      tbl.cos[i] = std::cos(phase);
+    }
+    return tbl;
+  }();
+  return instance;
+}
+
+}  // namespace trig
+}  // namespace phys
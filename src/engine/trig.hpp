@@ -0,0 +1,107 @@
+#ifndef ENGINE_TRIG_HPP
+#define ENGINE_TRIG_HPP
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Fused sin/cos of one phase at the accuracy tiers of SinCos, and of phases
+// kept as fixed-point fractions of a turn.
+
+namespace phys {
+namespace trig {
+
+constexpr const double TwoOverPi   = 0.63661977236758134308;
+constexpr const double PiOver2Hi   = 1.57079632673412561417e+00;
+constexpr const double PiOver2Mid  = 6.07710050630396597660e-11;
+constexpr const double PiOver2Lo   = 2.02226624871116645580e-21;
+
+// Adding 1.5 * 2^52 rounds to an integer and leaves it in the low mantissa bits.
+constexpr const double RoundMagic  = 6755399441055744.0;
+
+constexpr const double TwoPi       = 6.28318530717958647692;
+
+constexpr const size_t TableSize   = 4096;
+constexpr const double TableScale  = static_cast<double>(TableSize) / TwoPi;
+
+struct Table {
+  alignas(64) double sin[TableSize];
+  alignas(64) double cos[TableSize];
+};
+
+// sin and cos of 2 * pi * i / TableSize.
+const Table& table();
+
+// libm, the reference every other tier is measured against.
+inline void 
+exact(double x, double& s, double& c) {
+  c = std::cos(x);
+  s = std::sin(x);
+}
+
+// Quarter-turn reduction and short Taylor polynomials: error below 1e-7
+// for phases up to ~1e9 rad.
+inline void 
+poly(double x, double& s, double& c) {
+  double t = std::fma(x, TwoOverPi, RoundMagic);
+  double q = t - RoundMagic;
+  double r = std::fma(-q, PiOver2Hi, x);
+  r = std::fma(-q, PiOver2Mid, r);
+  double r2 = r * r;
+
+  double ps = r + r * r2 * (-1. / 6. + r2 * (1. / 120. + r2 * (-1. / 5040. + r2 * (1. / 362880.))));
+  double pc = 1. - 0.5 * r2 + r2 * r2 * (1. / 24. + r2 * (-1. / 720. + r2 * (1. / 40320.)));
+
+  switch(std::bit_cast<uint64_t>(t) & 3) {
+    case 0: s =  ps; c =  pc; break;
+    case 1: s =  pc; c = -ps; break;
+    case 2: s = -ps; c = -pc; break;
+    case 3: 
+    default:
+            s = -pc; c =  ps; break;
+  }
+}
+
+// Nearest table entry: error up to ~8e-4, for interactive previews only.
+inline void 
+lookup(const Table& tbl, double x, double& s, double& c) {
+  size_t i = std::bit_cast<uint64_t>(std::fma(x, TableScale, RoundMagic)) & (TableSize - 1);
+  s = tbl.sin[i];
+  c = tbl.cos[i];
+}
+
+// Phase as a 32-bit fraction of a full turn. Whole turns are gone before
+// the phase is stored, so nothing is left to range-reduce and the phase
+// keeps 32 bits of precision at any distance.
+using Turns = uint32_t;
+
+constexpr const double TurnScale   = 4294967296.0; // 2^32
+constexpr const unsigned TurnShift = 20;           // 32 - log2(TableSize)
+constexpr const Turns  TurnRestMask = (Turns{1} << TurnShift) - 1;
+constexpr const double RadiansPerTurnStep = TwoPi / TurnScale;
+
+// Drops whole turns in double, where it is exact, and keeps the fraction.
+inline Turns 
+toTurns(double turns) {
+  double fraction = turns - std::floor(turns);
+  return static_cast<Turns>(static_cast<uint64_t>(fraction * TurnScale));
+}
+
+// Table entry for the top bits plus a short Taylor correction for the
+// rest: error below 1e-15 with no range reduction.
+inline void 
+turns(const Table& tbl, Turns t, double& s, double& c) {
+  size_t i = t >> TurnShift;
+  double d  = static_cast<double>(t & TurnRestMask) * RadiansPerTurnStep;
+  double d2 = d * d;
+  double sd = d - d * d2 * (1. / 6.);
+  double cd = 1. - d2 * (0.5 - d2 * (1. / 24.));
+  s = tbl.sin[i] * cd + tbl.cos[i] * sd;
+  c = tbl.cos[i] * cd - tbl.sin[i] * sd;
+}
+
+}  // namespace trig
+}  // namespace phys
+
+#endif /* ENGINE_TRIG_HPP */
@@ -16,10 +16,11 @@ struct WavyEnvironment {
 // Now spheric wave
 class EWave {
     Complex<EFieldVal> m_wave;
-    EWave(Complex<EFieldVal> wave) : m_wave(wave) {}
 public:
     EWave(EFieldVal val = EFieldVal{}, NoUnit phase_0 = NoUnit{});
 
+    explicit EWave(Complex<EFieldVal> wave) : m_wave(wave) {}
+
     EWave traveled(LengthVal l, WavyEnvironment env) const {
         return EWave{(m_wave * (env.eLossCoeff / l)).rotate(l / env.waveLength)};
     }
@@ -29,6 +30,10 @@ public:
         return *this;
     }
 
+    const Complex<EFieldVal>& getComplex() const {
+        return m_wave;
+    }
+
     Brightness getIntensity() const {
         return m_wave.Len2();
     }
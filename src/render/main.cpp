@@ -0,0 +1,320 @@
+#include "chamber.hpp"
+#include "parallel.hpp"
+#include "presets.hpp"
+#include "raw.hpp"
+#include "scenefile.hpp"
+#include "screen.hpp"
+#include "tonemap.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Renders a scene without a window: runs the chamber on its screen,
+// reports how long it took and writes the picture and the raw intensity.
+//
+//   physrender [options]
+//
+//   --preset NAME        one of phys::presets::names(), fresnel by default
+//   --scene FILE         a scene file instead, see scenefile.hpp
+//   --method M           direct, fft, lookup, chirpz, paraxial or tree
+//   --kernel K           scalar or simd
+//   --sincos S           exact, poly or table
+//   --precision P        double or mixed
+//   --threads N          0 (the default) uses every core
+//   --resolution N       screen points per side, the scene's by default
+//   --lights L,...       red, green, blue or a frequency in THz
+//   --exposure E         times the automatic white point
+//   --gamma G
+//   --log                log10 scale
+//   --repeat N           updates from scratch that are timed, 1 by default
+//   --out PREFIX         writes PREFIX.ppm and PREFIX.raw
+//
+// PREFIX.raw is the line "PHYSRAW nx ny channels" followed by the float32
+// intensity of every channel, channel after channel, point x * ny + y of
+// each. The picture has x to the right and y downwards.
+
+using namespace phys;
+
+namespace {
+
+// Share of the pixels below white with the automatic exposure.
+constexpr const double WhitePercentile = 0.999;
+
+struct Options {
+  std::string preset = "fresnel";
+  std::string scene{};
+  PropagationConfig config{};
+  size_t threads = 0;
+  size_t resolution = 0;
+  std::vector<Frequency> lights{};
+  double exposure = 1.;
+  tonemap::Curve curve{};
+  size_t repeat = 1;
+  std::string out{};
+};
+
+[[noreturn]] void
+usage(const std::string& error) {
+  std::cerr << "physrender: " << error << "\n"
+            << "usage: physrender [--preset NAME | --scene FILE] [--method M] [--kernel K]\n"
+            << "                  [--sincos S] [--precision P] [--threads N] [--resolution N]\n"
+            << "                  [--lights L,...] [--exposure E] [--gamma G] [--log]\n"
+            << "                  [--repeat N] [--out PREFIX]\n";
+  exit(2);
+}
+
+template <typename E>
+E
+choose(const std::string& option, const std::string& value, const std::map<std::string, E>& choices) {
+  auto found = choices.find(value);
+  if(found == choices.end()) {
+    usage("unknown " + option + " " + value);
+  }
+  return found->second;
+}
+
+double
+number(const std::string& option, const std::string& value) {
+  char* end = nullptr;
+  const double parsed = std::strtod(value.c_str(), &end);
+  if(value.empty() || *end != '\0') {
+    usage(option + " takes a number, not " + value);
+  }
+  return parsed;
+}
+
+size_t
+count(const std::string& option, const std::string& value) {
+  const double parsed = number(option, value);
+  if(parsed < 0 || !raw::same(parsed, static_cast<double>(static_cast<size_t>(parsed)))) {
+    usage(option + " takes a whole number, not " + value);
+  }
+  return static_cast<size_t>(parsed);
+}
+
+std::vector<Frequency>
+frequencies(const std::string& value) {
+  static const std::map<std::string, Frequency> Named{
+    {"red", consts::red}, {"green", consts::green}, {"blue", consts::blue}};
+
+  std::vector<Frequency> fs;
+  std::stringstream list(value);
+  std::string item;
+  while(std::getline(list, item, ',')) {
+    auto named = Named.find(item);
+    if(named != Named.end()) {
+      fs.push_back(named->second);
+    } else {
+      fs.push_back(num_t{number("--lights", item)} * Tera * 1_Hz);
+    }
+  }
+  if(fs.empty() || fs.size() > Field::MaxChannels) {
+    usage("--lights takes 1 to " + std::to_string(Field::MaxChannels) + " frequencies");
+  }
+  return fs;
+}
+
+Options
+parse(int argc, char* argv[]) {
+  Options options;
+  for(int i = 1; i < argc; ++i) {
+    const std::string option = argv[i];
+    if(option == "--log") {
+      options.curve.log = true;
+      continue;
+    }
+    static const std::set<std::string> Valued{
+      "--preset", "--scene", "--method", "--kernel", "--sincos", "--precision", "--threads", "--resolution",
+      "--lights", "--exposure", "--gamma", "--repeat", "--out"};
+    if(Valued.count(option) == 0) {
+      usage("unknown option " + option);
+    }
+    if(i + 1 == argc) {
+      usage(option + " takes a value");
+    }
+    const std::string value = argv[++i];
+
+    if(option == "--preset") {
+      options.preset = value;
+    } else if(option == "--scene") {
+      options.scene = value;
+    } else if(option == "--method") {
+      options.config.method = choose<Method>(option, value, {
+        {"direct", Method::Direct}, {"fft", Method::Fft}, {"lookup", Method::Lookup},
+        {"chirpz", Method::ChirpZ}, {"paraxial", Method::Paraxial}, {"tree", Method::Tree}});
+    } else if(option == "--kernel") {
+      options.config.kernel = choose<Kernel>(option, value, {{"scalar", Kernel::Scalar}, {"simd", Kernel::Simd}});
+    } else if(option == "--sincos") {
+      options.config.sincos = choose<SinCos>(option, value, {
+        {"exact", SinCos::Exact}, {"poly", SinCos::Poly}, {"table", SinCos::Table}});
+    } else if(option == "--precision") {
+      options.config.precision = choose<Precision>(option, value, {
+        {"double", Precision::Double}, {"mixed", Precision::Mixed}});
+    } else if(option == "--threads") {
+      options.threads = count(option, value);
+    } else if(option == "--resolution") {
+      options.resolution = count(option, value);
+    } else if(option == "--lights") {
+      options.lights = frequencies(value);
+    } else if(option == "--exposure") {
+      options.exposure = number(option, value);
+    } else if(option == "--gamma") {
+      options.curve.gamma = number(option, value);
+    } else if(option == "--repeat") {
+      options.repeat = std::max<size_t>(count(option, value), 1);
+    } else if(option == "--out") {
+      options.out = value;
+    }
+  }
+  return options;
+}
+
+// Source-destination pairs a direct sum of every hop takes, the measure
+// of work whatever method did it.
+double
+pairs(std::vector<const Surface*> surfaces, const Screen& screen) {
+  std::sort(surfaces.begin(), surfaces.end(), [](const Surface* lhs, const Surface* rhs) -> bool {return lhs->getZ() < rhs->getZ();});
+  double total = 0.;
+  for(size_t i = 1; i < surfaces.size(); ++i) {
+    total += static_cast<double>(surfaces[i-1]->getField().size()) * static_cast<double>(surfaces[i]->getField().size());
+  }
+  if(!surfaces.empty()) {
+    total += static_cast<double>(surfaces.back()->getField().size()) * static_cast<double>(screen.grid().points());
+  }
+  return total;
+}
+
+void
+writeRaw(const std::string& path, const Intensity& intensity) {
+  std::ofstream out(path, std::ios::binary);
+  out << "PHYSRAW " << intensity.grid.nx << ' ' << intensity.grid.ny << ' ' << intensity.channels << '\n';
+  out.write(reinterpret_cast<const char*>(intensity.values.data()),
+            static_cast<std::streamsize>(intensity.values.size() * sizeof(float)));
+  if(!out) {
+    std::cerr << "physrender: cannot write " << path << '\n';
+    exit(1);
+  }
+}
+
+void
+writePpm(const std::string& path, const Intensity& intensity, const Options& options, const std::vector<Frequency>& lights) {
+  std::vector<tonemap::Rgb> colors;
+  for(Frequency f : lights) {
+    colors.push_back(tonemap::spectral(consts::c / f));
+  }
+  tonemap::Hdr hdr;
+  const tonemap::Stats stats = tonemap::accumulate(intensity, colors, hdr);
+  const float white = stats.percentile(WhitePercentile);
+  const float scale = white > 0.f ? static_cast<float>(options.exposure) / white : 0.f;
+
+  std::vector<uint32_t> argb(hdr.points);
+  tonemap::ToneMap(options.curve).apply(hdr, scale, argb.data());
+
+  const size_t nx = intensity.grid.nx;
+  const size_t ny = intensity.grid.ny;
+  std::vector<char> rgb;
+  rgb.reserve(3 * nx * ny);
+  for(size_t y = 0; y < ny; ++y) {
+    for(size_t x = 0; x < nx; ++x) {
+      const uint32_t pixel = argb[x * ny + y];
+      rgb.push_back(static_cast<char>(pixel >> 16));
+      rgb.push_back(static_cast<char>(pixel >> 8));
+      rgb.push_back(static_cast<char>(pixel));
+    }
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  out << "P6\n" << nx << ' ' << ny << "\n255\n";
+  out.write(rgb.data(), static_cast<std::streamsize>(rgb.size()));
+  if(!out) {
+    std::cerr << "physrender: cannot write " << path << '\n';
+    exit(1);
+  }
+}
+
+}  // namespace
+
+int
+main(int argc, char* argv[]) {
+  const Options options = parse(argc, argv);
+
+  std::optional<Scene> scene;
+  if(!options.scene.empty()) {
+    // The reader said what is wrong.
+    scene = scenefile::read(options.scene);
+    if(!scene) {
+      return 1;
+    }
+  } else {
+    scene = presets::preset(options.preset);
+    if(!scene) {
+      std::string known;
+      for(const std::string& name : presets::names()) {
+        known += " " + name;
+      }
+      usage("unknown preset " + options.preset + ", known are" + known);
+    }
+  }
+  if(!options.lights.empty()) {
+    scene->frequencies = options.lights;
+  }
+  const std::vector<Frequency> lights = scene->frequencies;
+
+  Screen screen(scene->screenTo);
+  screen.setResolution(options.resolution != 0 ? options.resolution : scene->resolution);
+  screen.setWindow(scene->screenFrom, scene->screenTo);
+
+  std::vector<const Surface*> surfaces;
+  for(const auto& surface : scene->surfaces) {
+    surfaces.push_back(surface.get());
+  }
+
+  Chamber chamber;
+  chamber.setThreadCount(options.threads);
+  chamber.setPropagation(options.config);
+  chamber.load(std::move(*scene));
+  chamber.addSurface(&screen);
+
+  // The first update also builds the plans and tables the methods keep,
+  // the repeats only propagate.
+  double first = 0.;
+  double best = 1e300;
+  double total = 0.;
+  for(size_t r = 0; r <= options.repeat; ++r) {
+    chamber.invalidate();
+    auto start = std::chrono::steady_clock::now();
+    chamber.update();
+    auto stop = std::chrono::steady_clock::now();
+    const double time = std::chrono::duration<double>(stop - start).count();
+    if(r == 0) {
+      first = time;
+    } else {
+      best = std::min(best, time);
+      total += time;
+    }
+  }
+
+  const double work = pairs(surfaces, screen) * static_cast<double>(lights.size());
+  std::cout << (options.scene.empty() ? options.preset : options.scene) << ": " << screen.grid().nx << "x" << screen.grid().ny << ", "
+            << lights.size() << " channel(s), " << parallel::threadCount() << " thread(s)\n"
+            << "  first update: " << first * 1e3 << " ms\n"
+            << "  update: " << best * 1e3 << " ms best, " << total / static_cast<double>(options.repeat) * 1e3
+            << " ms mean of " << options.repeat << "\n"
+            << "  " << work / best << " pairs/s (" << work << " direct pairs)\n";
+
+  if(!options.out.empty()) {
+    writePpm(options.out + ".ppm", screen.intensity(), options, lights);
+    writeRaw(options.out + ".raw", screen.intensity());
+  }
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "ProfileView.hpp"
+
+#include <QPainter>
+#include <algorithm>
+
+ProfileView::ProfileView(QWidget* parent)
+    : QWidget(parent)
+{
+}
+
+void
+ProfileView::setProfile(const phys::Field& field, size_t nx, size_t nz, const std::vector<QColor>& channelColors)
+{
+    if(field.size() != nx * nz) {
+        m_image = QImage();
+        update();
+        return;
+    }
+
+    m_image = QImage(static_cast<int>(nz), static_cast<int>(nx), QImage::Format_RGB32);
+    size_t channels = std::min(field.channels(), channelColors.size());
+
+    std::vector<double> intensity(nx * channels);
+    for(size_t k = 0; k < nz; ++k) {
+        double max = 0.;
+        for(size_t ch = 0; ch < channels; ++ch) {
+            const double* re = field.re(ch) + k * nx;
+            const double* im = field.im(ch) + k * nx;
+            for(size_t i = 0; i < nx; ++i) {
+                intensity[ch * nx + i] = re[i] * re[i] + im[i] * im[i];
+                max = std::max(max, intensity[ch * nx + i]);
+            }
+        }
+
+        for(size_t i = 0; i < nx; ++i) {
+            double r = 0., g = 0., b = 0.;
+            for(size_t ch = 0; ch < channels && max > 0.; ++ch) {
+                double value = intensity[ch * nx + i] / max;
+                r += value * channelColors[ch].redF();
+                g += value * channelColors[ch].greenF();
+                b += value * channelColors[ch].blueF();
+            }
+            QColor color;
+            color.setRgbF(static_cast<float>(std::min(1., r)),
+                          static_cast<float>(std::min(1., g)),
+                          static_cast<float>(std::min(1., b)));
+            m_image.setPixelColor(static_cast<int>(k), static_cast<int>(i), color);
+        }
+    }
+
+    update();
+}
+
+void
+ProfileView::paintEvent(QPaintEvent* /*event*/) {
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    if(!m_image.isNull()) {
+        painter.drawImage(rect(), m_image);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef PROFILEVIEW_HPP
+#define PROFILEVIEW_HPP
+
+#include "field.hpp"
+#include <QImage>
+#include <QWidget>
+
+// Beam profile along Z: the side view of Chamber::profile, z running left
+// to right and x top to bottom.
+class ProfileView final : public QWidget {
+    Q_OBJECT
+public:
+    explicit ProfileView(QWidget* parent = nullptr);
+
+    // nx points across on each of nz planes, point k * nx + i is point i
+    // of plane k. Every plane is scaled to its own brightest point, so the
+    // shape of the beam shows over the 1/r falloff.
+    void setProfile(const phys::Field& field, size_t nx, size_t nz, const std::vector<QColor>& channelColors);
+
+private:
+    QImage m_image;
+
+    void paintEvent(QPaintEvent* event) override;
+};
+
+#endif // PROFILEVIEW_HPP
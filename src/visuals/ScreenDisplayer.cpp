@@ -4,19 +4,27 @@
 #include <QDateTimeEdit>
 #include <QDebug>
 #include <QPainter>
-#include <QPen>
 #include <QPushButton>
 #include <QSpinBox>
 #include <QTimer>
+#include <QTransform>
 #include <iostream>
 
 #include "sizes.hpp"
 
+namespace {
+
+// Share of the pixels below white, as physrender exposes them.
+constexpr const double WhitePercentile = 0.999;
+
+}  // namespace
+
 ScreenDisplayer::ScreenDisplayer(QWidget* parent)
-    : QWidget(parent), phys::ContigSurface({XBoxSize, XBoxSize})
+    : QWidget(parent), phys::Screen({XBoxSize, XBoxSize}),
+      m_image(ScreenResolution, ScreenResolution, QImage::Format_RGB32)
 {
     resetColors();
-    setResolution(std::min(width(), height()));
+    setResolution(ScreenResolution);
 }
 
 ScreenDisplayer::~ScreenDisplayer() {}
@@ -24,23 +32,21 @@ ScreenDisplayer::~ScreenDisplayer() {}
 void
 ScreenDisplayer::setCurrentColor(const QColor& newCurrentColor)
 {
-    m_currentColor = newCurrentColor;
+    m_channelColors = {newCurrentColor};
 }
 
+void
+ScreenDisplayer::setChannelColors(std::vector<QColor> colors)
+{
+    m_channelColors = std::move(colors);
+}
+
+// A window resize only stretches the image, the screen keeps its points.
 void
 ScreenDisplayer::paintEvent(QPaintEvent* /*event*/) {
     QPainter painter(this);
-    QPen pen;
-    
-    assert(m_colors.size() == width() * height());
-
-    for(int i = 0; i < width(); ++i) {
-        for(int j = 0; j < height(); ++j) {
-            pen.setColor(m_colors[i*height() + j]);
-            painter.setPen(pen);
-            painter.drawPoint(i, j);
-        }
-    }
+    painter.setTransform(QTransform(0, 1, 1, 0, 0, 0));
+    painter.drawImage(QRect(0, 0, height(), width()), m_image);
 }
 
 void ScreenDisplayer::setBrightness(int x)
@@ -49,50 +55,52 @@ void ScreenDisplayer::setBrightness(int x)
 }
 
 void 
-ScreenDisplayer::resizeEvent(QResizeEvent* event){
-  QWidget::resizeEvent(event);
-  assert(height() == width());
-  setResolution(width());
-  resetColors();
+ScreenDisplayer::display(const phys::Intensity& intensity) {
+    if(fitImage(&intensity.grid)) {
+        recolor(phys::tonemap::accumulate(intensity, colors(), m_hdr));
+    }
 }
 
 void 
-ScreenDisplayer::update(const std::vector<phys::LightSource>& srcs) {
-    phys::ContigSurface::update(srcs);
-    recolor();
+ScreenDisplayer::display(const phys::Field& field) {
+    if(!field.empty() && fitImage(field.grid())) {
+        recolor(phys::tonemap::accumulate(field, colors(), m_hdr));
+    }
 }
 
-void ScreenDisplayer::recolor()
+// Point x * ny + y of the grid is pixel (x, y), so scan line x of the
+// transposed image is points x * ny to x * ny + ny.
+bool 
+ScreenDisplayer::fitImage(const phys::GridLayout* grid)
 {
-    const auto& lights = getSrcs();
-    if(lights.empty())
-        return;
-
-    if(lights.size() != width() * height()) {
-        qDebug() << "lights.size() != width() * height()\n";
-        return;
+    if(grid == nullptr || !grid->cells.empty()) {
+        qDebug() << "the screen field is not a full grid\n";
+        return false;
     }
-
-    if(*m_maxBrightness == 0.) {
-        for(const auto& [wave,_] : lights) {
-            m_maxBrightness = std::max(m_maxBrightness, wave.getIntensity());
-        }
+    const int nx = static_cast<int>(grid->nx);
+    const int ny = static_cast<int>(grid->ny);
+    if(m_image.width() != ny || m_image.height() != nx) {
+        m_image = QImage(ny, nx, QImage::Format_RGB32);
     }
+    return true;
+}
 
-    for(int i = 0; i < width(); ++i) {
-        for(int j = 0; j < height(); ++j) {
-            double value = m_brightness * (lights[i*height() + j].first.getIntensity() / m_maxBrightness)->getVal();
-            value = std::min(1., value);
-            if(m_currentColor == Qt::red) {
-                m_colors[i*height()+j].setRedF(static_cast<float>(value));
-            } else if (m_currentColor == Qt::green) {
-                m_colors[i*height()+j].setGreenF(static_cast<float>(value));
-            } else if (m_currentColor == Qt::blue) {
-                m_colors[i*height()+j].setBlueF(static_cast<float>(value));
-            } else {
-                qDebug() << "Wrong color\n";
-                abort();
-            }
-        }
+std::vector<phys::tonemap::Rgb> 
+ScreenDisplayer::colors() const
+{
+    std::vector<phys::tonemap::Rgb> colors;
+    for(const QColor& color : m_channelColors) {
+        colors.push_back({color.redF(), color.greenF(), color.blueF()});
     }
+    return colors;
+}
+
+// Every frame is exposed on its own: the intensity that a WhitePercentile
+// share of its pixels stays below is white at full brightness, so power
+// edits and new lights neither saturate nor darken the picture.
+void ScreenDisplayer::recolor(const phys::tonemap::Stats& stats)
+{
+    const float white = stats.percentile(WhitePercentile);
+    const float scale = white > 0.f ? static_cast<float>(m_brightness) / white : 0.f;
+    m_toneMap.apply(m_hdr, scale, reinterpret_cast<uint32_t*>(m_image.bits()));
 }
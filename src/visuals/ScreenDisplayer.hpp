@@ -1,40 +1,60 @@
 #ifndef UNIVERSEDISPLAYER_HPP
 #define UNIVERSEDISPLAYER_HPP
 
-#include "surface.hpp"
+#include "screen.hpp"
+#include "tonemap.hpp"
+#include <QImage>
 #include <QVector>
 #include <QWidget>
 
 class QSpinBox;
 class QPushButton;
 
-class ScreenDisplayer final : public QWidget, public phys::ContigSurface {
+class ScreenDisplayer final : public QWidget, public phys::Screen {
     Q_OBJECT
 public:
     explicit ScreenDisplayer(QWidget* parent = nullptr);
     ~ScreenDisplayer() override;
 
-    phys::Surface* getSurface() { return this; }
+    phys::Screen* getSurface() { return this; }
 
     void setCurrentColor(const QColor& newCurrentColor);
 
+    // Colour each field channel (wavelength) is painted with.
+    void setChannelColors(std::vector<QColor> colors);
+
+    const std::vector<QColor>& channelColors() const { return m_channelColors; }
+
+    // Paints a frame of this screen.
+    void display(const phys::Intensity& intensity);
+
+    // Paints a field on the points of this screen, e.g. one of
+    // Chamber::sweep, without making it the screen's own field.
+    void display(const phys::Field& field);
+
 private:
     double m_brightness = 1.0;
-    std::vector<QColor> m_colors;
+
+    // One pixel per screen point, written by recolor and stretched over
+    // the widget by paintEvent. Transposed: scan line x holds the points
+    // of column x, which follow each other in the field.
+    QImage m_image;
     
-    QColor m_currentColor = Qt::red;
+    std::vector<QColor> m_channelColors{Qt::red};
 
-    void resizeEvent(QResizeEvent* event) override;
+    phys::tonemap::Hdr m_hdr;
+    phys::tonemap::ToneMap m_toneMap;
 
-    void update(const std::vector<phys::LightSource>& srcs) override;
+    // Fits the image to an nx by ny grid, false if there is none.
+    bool fitImage(const phys::GridLayout* grid);
 
-    phys::Brightness m_maxBrightness;
+    std::vector<phys::tonemap::Rgb> colors() const;
 
-    void recolor();
+    void recolor(const phys::tonemap::Stats& stats);
 public slots:
     void 
     resetColors() {
-        m_colors.assign(height()*width(), Qt::black);
+        m_image.fill(Qt::black);
     }
 
     void paintEvent(QPaintEvent* event) override;
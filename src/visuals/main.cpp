@@ -1,12 +1,23 @@
 #include "mainwindow.hpp"
+#include "presets.hpp"
+#include "scenefile.hpp"
 
 #include <QApplication>
 #include <QDebug>
 #include <QLoggingCategory>
 
+// light [SCENE], a scene file as scenefile.hpp describes it; the Fresnel
+// lens preset without one.
 int main(int argc, char* argv[]) {
     QApplication a(argc, argv);
-    MainWindow w;
+
+    // The reader said what is wrong.
+    std::optional<phys::Scene> scene = argc > 1 ? phys::scenefile::read(argv[1]) : phys::presets::fresnel();
+    if(!scene) {
+        return 1;
+    }
+
+    MainWindow w(std::move(*scene));
     w.show();
     return a.exec();
 }
@@ -2,174 +2,96 @@
 #include "ui_mainwindow.h"
 
 #include "physconstants.hpp"
+#include "ProfileView.hpp"
 #include "physicsthread.hpp"
 #include "sizes.hpp"
 #include <QDebug>
+#include <QSignalBlocker>
 #include <QTimer>
+#include <algorithm>
 
 
+// Planes of the last hop in the animation, and points across by planes
+// in the profile view.
+constexpr const size_t AnimationFrames = 100;
+constexpr const size_t ProfileWidth    = 200;
+constexpr const size_t ProfileDepth    = 400;
+
+namespace {
+
+// Colour a channel is painted with: the one of its power control, or
+// that of its wavelength for wavelengths without a control.
+QColor channelColor(phys::Frequency frequency) {
+    if(frequency == phys::consts::red)   return Qt::red;
+    if(frequency == phys::consts::green) return Qt::green;
+    if(frequency == phys::consts::blue)  return Qt::blue;
+    const phys::tonemap::Rgb rgb = phys::tonemap::spectral(phys::consts::c / frequency);
+    return QColor::fromRgbF(rgb.r, rgb.g, rgb.b);
+}
+
+}  // namespace
+
 // const constexpr phys::Position DisplayerPos = {phys::Length{0.0}, phys::Length{0.0}, ZDisplayerCoord + ZDisplayerCoord};
 
 
-MainWindow::MainWindow(QWidget* parent)
+MainWindow::MainWindow(phys::Scene scene, QWidget* parent)
     : QMainWindow(parent)
-    , ui(new Ui::MainWindow)
-    , m_physThread(nullptr) {
+    , ui(new Ui::MainWindow) {
 
-//    m_physThread->cont();
     ui->setupUi(this);
 
-//    presetYng();
-   // presetDifr();
-    // presetLens();
-    presetFrenel();
+    loadScene(std::move(scene));
 
     m_surfaces.addSurface(ui->displayer->getSurface());
-    m_surfaces.update();
+    m_surfaces.setPropagation({phys::Kernel::Simd});
+    m_surfaces.setMethod(phys::Method::Fft);
 
+    m_physThread = new PhysicsThread(m_surfaces, *ui->displayer->getSurface(), this);
     connectControls();
+
+    // From here on the chamber is the worker's, which computes it first.
+    m_physThread->start(QThread::LowPriority);
 }
 
 MainWindow::~MainWindow() {
+    // Stops it before the chamber and the screen it computes go away.
+    delete m_physThread;
     delete ui;
 }
 
-void MainWindow::resizeEvent(QResizeEvent* event) {
-    QMainWindow::resizeEvent(event);
-    if(m_tracking) {
-        physRecalc();
-    }
-}
-
-void MainWindow::presetYng()
-{
-    constexpr const phys::Length YngLightZ   = -2_m;
-    constexpr const phys::Length YngBarrierZ = -1_m;
-
-    ui->horizontalSlider->setMinimum(2 * (YngLightZ / ZScale)->getVal());
-
-    m_lights = new phys::PointLights();
-    m_lights->addSource(std::make_pair(phys::EWave{phys::EFieldVal{1.}}, phys::Position{XMid, XMid, YngLightZ}));
-    m_surfaces.addSurface(m_lights);
-    ui->horizontalSlider->addSlider((YngLightZ / ZScale)->getVal());
-
-    constexpr const phys::Position Hole2Pos = {XMid, XMid + 1e-3_m, YngBarrierZ};
-    constexpr const phys::Position Hole1Pos = {XMid, XMid - 1e-3_m, YngBarrierZ};
-
-    auto* barrier = new phys::PointsBarrier();
-    barrier->addHole(Hole1Pos);
-    barrier->addHole(Hole2Pos);
-    m_surfaces.addSurface(barrier);
-    ui->horizontalSlider->addSlider((barrier->getZ() / ZScale)->getVal());
-}
-
-
-void MainWindow::presetDifr()
+// Sliders for the z of every surface, the screen where the scene wants
+// it; its resolution stays the one of the widget. The lights shine as the
+// scene says until a power control is edited, the controls of colours it
+// does not have start at zero.
+void MainWindow::loadScene(phys::Scene scene)
 {
-    m_tracking = false;
-
-    constexpr const phys::Length DifrLightZ   = -2_m;
-    constexpr const phys::Length DifrBarrierZ = -1_m;
-    constexpr const phys::Position DifrLightPos{XMid, XMid, DifrLightZ};
-    constexpr const phys::Position DifrBarrierPos{XBoxSize, XBoxSize, DifrBarrierZ};
-
-    ui->horizontalSlider->setMinimum(2 * (DifrLightZ / ZScale)->getVal());
-
-    m_lights = new phys::PointLights();
-    m_lights->addSource(std::make_pair(phys::EWave{phys::EFieldVal{1.}}, DifrLightPos));
-    m_surfaces.addSurface(m_lights);
-    ui->horizontalSlider->addSlider((DifrLightZ / ZScale)->getVal());
-
-    phys::Length redLen = phys::consts::c / phys::consts::red;
-
-    auto transparent = [=](phys::Position pos) -> bool {
-        auto lens = ((DifrLightPos - pos).Len() + (pos - phys::Position{XMid, XMid}).Len()) / redLen;
-        double val = lens->getVal();
-//        std::cerr << (val - static_cast<long>(val)) << "\n";
-        return (val - static_cast<long>(val)) <= 0.5;
-    };
-
-    auto* barrier = new phys::ContigSurface(DifrBarrierPos, transparent);
-    m_surfaces.addSurface(barrier);
-    ui->horizontalSlider->addSlider((barrier->getZ() / ZScale)->getVal());
-    barrier->setResolution(10);
-    //    barrier->setResolution(50); // Sloooowly generates caleidoscope;
-}
-
-void MainWindow::presetLens()
-{
-    m_tracking = false;
-
-    constexpr const phys::Length DifrLightZ   = -2_m;
-    constexpr const phys::Length DifrBarrierZ = -1_m;
-    constexpr const phys::Position DifrLightPos{XMid, XMid, DifrLightZ};
-    constexpr const phys::Position DifrBarrierPos{XBoxSize, XBoxSize, DifrBarrierZ};
-    constexpr const phys::Position DifrBarrierPos2{XBoxSize, XBoxSize, DifrBarrierZ + 10.__ * ZScale};
-
-    ui->horizontalSlider->setMinimum(2 * (DifrLightZ / ZScale)->getVal());
-
-    m_lights = new phys::PointLights();
-    m_lights->addSource(std::make_pair(phys::EWave{phys::EFieldVal{1.}}, DifrLightPos));
-    m_surfaces.addSurface(m_lights);
-    ui->horizontalSlider->addSlider((DifrLightZ / ZScale)->getVal());
-
-    phys::Length redLen = phys::consts::c / phys::consts::red;
-
-    auto transform = [=](phys::Position pos) -> phys::Position {
-        pos.Z() += phys::sqrt(XMid * XMid - (pos.X() - XMid) * (pos.X() - XMid) + (pos.Y() - XMid) * (pos.Y() - XMid));
-        return pos;
-    };
-
-    auto* barrier1 = new phys::ContigSurface(DifrBarrierPos);
-    m_surfaces.addSurface(barrier1);
-    ui->horizontalSlider->addSlider((barrier1->getZ() / ZScale)->getVal());
-    barrier1->setResolution(30);
+    m_lights = scene.lights;
+    m_tracking = scene.interactive;
+    m_sceneLights = true;
 
-    auto* barrier2 = new phys::ContigSurface(DifrBarrierPos2, transform);
-    m_surfaces.addSurface(barrier2);
-    ui->horizontalSlider->addSlider((barrier2->getZ() / ZScale)->getVal());
-    barrier2->setResolution(30);
-
-    m_surfaces.setRefractiveIndex(1, 1.43__);
-}
-
-void
-MainWindow::presetFrenel() {
-    m_tracking = false;
-
-    constexpr const phys::Length DifrLightZ   = -2_m;
-    constexpr const phys::Length DifrBarrierZ = -1_m;
-    constexpr const phys::Position DifrLightPos{XMid, XMid, DifrLightZ};
-    constexpr const phys::Position DifrBarrierPos{XBoxSize, XBoxSize, DifrBarrierZ};
-    constexpr const phys::Position DifrBarrierPos2{XBoxSize, XBoxSize, DifrBarrierZ + 10.__ * ZScale};
-
-    ui->horizontalSlider->setMinimum(2 * (DifrLightZ / ZScale)->getVal());
-
-    m_lights = new phys::PointLights();
-    m_lights->addSource(std::make_pair(phys::EWave{phys::EFieldVal{1.}}, DifrLightPos));
-    m_surfaces.addSurface(m_lights);
-    ui->horizontalSlider->addSlider((DifrLightZ / ZScale)->getVal());
-
-    phys::Length redLen = phys::consts::c / phys::consts::red;
-
-    auto transform = [=](phys::Position pos) -> phys::Position {
-        phys::Length l = phys::sqrt(XMid * XMid - (pos.X() - XMid) * (pos.X() - XMid) + (pos.Y() - XMid) * (pos.Y() - XMid));
-        l -= phys::num_t(floor((l / (redLen * 1.43__))->getVal())) * redLen * 1.43__;
-        pos.Z() += l;
-        return pos;
-    };
-
-    auto* barrier1 = new phys::ContigSurface(DifrBarrierPos);
-    m_surfaces.addSurface(barrier1);
-    ui->horizontalSlider->addSlider((barrier1->getZ() / ZScale)->getVal());
-    barrier1->setResolution(30);
+    std::vector<QColor> colors;
+    for(phys::Frequency frequency : scene.frequencies) {
+        colors.push_back(channelColor(frequency));
+    }
+    ui->displayer->setChannelColors(colors);
+    for(const auto& [power, frequency] : {std::pair{ui->RPower, phys::consts::red},
+                                          std::pair{ui->GPower, phys::consts::green},
+                                          std::pair{ui->BPower, phys::consts::blue}}) {
+        if(std::find(scene.frequencies.begin(), scene.frequencies.end(), frequency) == scene.frequencies.end()) {
+            const QSignalBlocker blocker(power);
+            power->setValue(0);
+        }
+    }
 
-    auto* barrier2 = new phys::ContigSurface(DifrBarrierPos2, transform);
-    m_surfaces.addSurface(barrier2);
-    ui->horizontalSlider->addSlider((barrier2->getZ() / ZScale)->getVal());
-    barrier2->setResolution(30);
+    if(!scene.surfaces.empty()) {
+        ui->horizontalSlider->setMinimum(2 * (scene.surfaces.front()->getZ() / ZScale)->getVal());
+    }
+    for(const auto& surface : scene.surfaces) {
+        ui->horizontalSlider->addSlider((surface->getZ() / ZScale)->getVal());
+    }
+    ui->displayer->setWindow(scene.screenFrom, scene.screenTo);
 
-    m_surfaces.setRefractiveIndex(1, 1.43__);
+    m_surfaces.load(std::move(scene));
 }
 
 void MainWindow::toggleSimulation(bool run) {
@@ -181,74 +103,137 @@ void MainWindow::toggleSimulation(bool run) {
         m_physThread->stop();
 }
 
-void MainWindow::setSimulationSpeed(int x) {
-    m_physThread->setPeriod(x);
-}
-
 void MainWindow::updateMetrics() {
 
 }
 
+// The screen swept through the last hop, from the surface in front of it
+// to where it stands. Only that hop changes between frames, so all of them
+// are summed in one batched pass.
 void MainWindow::animation() {
-    for(int i = ui->horizontalSlider->maximum(); i > ui->horizontalSlider->minimum() / 2; i -= 3) {
-        ui->horizontalSlider->setSliderValue(1, i);
-        setDistance(1, i);
-        if(!m_tracking)
-            physRecalc();
-        update();
+    m_physThread->query([this](const phys::Chamber& chamber) {
+        auto frames = std::make_shared<const std::vector<phys::Field>>(chamber.sweep(AnimationFrames));
+        QMetaObject::invokeMethod(this, [this, frames] {
+            for(const phys::Field& frame : *frames) {
+                ui->displayer->display(frame);
+                ui->displayer->repaint();
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::showProfile() {
+    if(m_profile == nullptr) {
+        m_profile = new ProfileView(this);
+        m_profile->setWindowFlags(Qt::Window);
+        m_profile->setWindowTitle("Beam profile along Z");
+        m_profile->resize(2 * ProfileWidth, ProfileWidth);
     }
-    // setDistance(1, ui->horizontalSlider->va);  
+    m_physThread->query([this](const phys::Chamber& chamber) {
+        auto profile = std::make_shared<const phys::Field>(chamber.profile(ProfileWidth, ProfileDepth));
+        QMetaObject::invokeMethod(this, [this, profile] {
+            m_profile->setProfile(*profile, ProfileWidth, ProfileDepth, ui->displayer->channelColors());
+            m_profile->show();
+        }, Qt::QueuedConnection);
+    });
 }
 
+void MainWindow::showFrame(std::shared_ptr<const phys::Intensity> frame)
+{
+    ui->displayer->display(*frame);
+    ui->displayer->repaint();
+}
 
 void MainWindow::physRecalc()
 {
-    ui->displayer->resetColors();
-    if(m_lights == nullptr) return;
+    requestUpdate(false);
+}
 
-    if(ui->RPower->value() != 0) {
-        m_lights->setPower(phys::EFieldVal(ui->RPower->value()));
-        m_surfaces.setLight(phys::consts::red);
-        ui->displayer->setCurrentColor(Qt::red);
-        m_surfaces.update();
+// Same as physRecalc, but with the table sin/cos first, for slider drags.
+void MainWindow::physPreview()
+{
+    requestUpdate(true);
+}
+
+void MainWindow::editPowers()
+{
+    m_sceneLights = false;
+}
+
+// Reads the controls here and leaves the chamber to the worker; the frame
+// comes back through showFrame. Until a power control is edited the lights
+// stay those of the scene.
+void MainWindow::requestUpdate(bool preview)
+{
+    if(m_lights == nullptr) return;
+    if(m_sceneLights) {
+        m_physThread->recompute(preview);
+        return;
     }
 
-    if(ui->GPower->value() != 0) {
-        m_lights->setPower(phys::EFieldVal(ui->GPower->value()));
-        m_surfaces.setLight(phys::consts::green);
-        ui->displayer->setCurrentColor(Qt::green);
-        m_surfaces.update();
+    struct Light {
+        phys::Frequency frequency;
+        QColor color;
+        int power;
+    };
+
+    std::vector<phys::Frequency> frequencies;
+    std::vector<QColor> colors;
+    std::vector<phys::EFieldVal> powers;
+    for(const Light& light : {Light{phys::consts::red,   Qt::red,   ui->RPower->value()},
+                              Light{phys::consts::green, Qt::green, ui->GPower->value()},
+                              Light{phys::consts::blue,  Qt::blue,  ui->BPower->value()}}) {
+        if(light.power != 0) {
+            frequencies.push_back(light.frequency);
+            colors.push_back(light.color);
+            powers.push_back(phys::EFieldVal(light.power));
+        }
     }
 
-    if(ui->BPower->value() != 0) {
-        m_lights->setPower(phys::EFieldVal(ui->BPower->value()));
-        m_surfaces.setLight(phys::consts::blue);
-        ui->displayer->setCurrentColor(Qt::blue);
-        m_surfaces.update();
+    if(frequencies.empty()) {
+        ui->displayer->resetColors();
+        ui->displayer->repaint();
+        return;
     }
-    
-    ui->displayer->repaint();
+
+    ui->displayer->setChannelColors(colors);
+    phys::PointLights* lights = m_lights;
+    m_physThread->edit([lights, frequencies, powers](phys::Chamber& chamber) {
+        for(size_t ch = 0; ch < powers.size(); ++ch) {
+            lights->setPower(ch, powers[ch]);
+        }
+        chamber.setLights(frequencies);
+    });
+    m_physThread->recompute(preview);
 }
 
 void MainWindow::setDistance(int n, int x)
 {
-    std::cerr << x << "\n";
-    m_surfaces.setZ(n, phys::num_t{x} * ZScale);
+    const phys::Length z = phys::num_t{x} * ZScale;
+    m_physThread->edit([n, z](phys::Chamber& chamber) {
+        chamber.setZ(n, z);
+    });
 }
 
 void MainWindow::connectControls()
 {
     connect(ui->brightness, SIGNAL(valueChanged(int)), ui->displayer, SLOT(setBrightness(int)));
     connect(ui->horizontalSlider, SIGNAL(valueChangedNth(int,int)), this, SLOT(setDistance(int,int)));
+    // Before the recomputes below, which read the flag.
+    connect(ui->RPower, SIGNAL(valueChanged(int)), this, SLOT(editPowers()));
+    connect(ui->GPower, SIGNAL(valueChanged(int)), this, SLOT(editPowers()));
+    connect(ui->BPower, SIGNAL(valueChanged(int)), this, SLOT(editPowers()));
 
     if(m_tracking) {
         connect(ui->RPower, SIGNAL(valueChanged(int)), this, SLOT(physRecalc()));
         connect(ui->GPower, SIGNAL(valueChanged(int)), this, SLOT(physRecalc()));
         connect(ui->BPower, SIGNAL(valueChanged(int)), this, SLOT(physRecalc()));
         connect(ui->brightness, SIGNAL(valueChanged(int)), this, SLOT(physRecalc()));
-        connect(ui->horizontalSlider, SIGNAL(valueChangedNth(int,int)), this, SLOT(physRecalc()));
+        connect(ui->horizontalSlider, SIGNAL(valueChangedNth(int,int)), this, SLOT(physPreview()));
     }
     connect(ui->upd, SIGNAL(clicked()), this, SLOT(physRecalc()));
     connect(ui->anime, SIGNAL(clicked()), this, SLOT(animation()));
+    connect(ui->profile, SIGNAL(clicked()), this, SLOT(showProfile()));
+    connect(m_physThread, &PhysicsThread::frameReady, this, &MainWindow::showFrame);
 
 }
@@ -5,12 +5,14 @@
 #include "chamber.hpp"
 #include <QMainWindow>
 #include <array>
+#include <memory>
 #include <QElapsedTimer>
 
 namespace Ui {
 class MainWindow;
 }
 class PhysicsThread;
+class ProfileView;
 class QTimer;
 class QElapsedTimer;
 class QLineEdit;
@@ -19,12 +21,9 @@ class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget* parent = nullptr);
+    explicit MainWindow(phys::Scene scene, QWidget* parent = nullptr);
     ~MainWindow() override;
 
-    void resizeEvent(QResizeEvent* event) override;
-
-
 private:
     Ui::MainWindow* ui;
 
@@ -34,28 +33,39 @@ private:
     QElapsedTimer m_elapsed;
 
     phys::Chamber m_surfaces;
-    PhysicsThread* m_physThread;
+    PhysicsThread* m_physThread = nullptr;
 
     size_t m_currentAtom = 0;
 
     phys::PointLights* m_lights    = nullptr;
 
-    void presetYng();
-    void presetDifr();
-    void presetLens();
-//    void presetFrenel();
+    ProfileView* m_profile = nullptr;
+
+    void loadScene(phys::Scene scene);
+
+    void requestUpdate(bool preview);
 
     bool m_tracking = true;
 
+    // No power control was edited since the scene was loaded, so its own
+    // wavelengths and amplitudes are kept.
+    bool m_sceneLights = true;
+
 private slots:
     void animation();
+    void showProfile();
     void toggleSimulation(bool);
-    void setSimulationSpeed(int);
 
     void updateMetrics();
 
     void physRecalc();
 
+    void physPreview();
+
+    void editPowers();
+
+    void showFrame(std::shared_ptr<const phys::Intensity> frame);
+
     void setDistance(int, int);
 
     void connectControls();
@@ -1,36 +1,91 @@
 #include "physicsthread.hpp"
+#include "parallel.hpp"
 #include <QMutexLocker>
-#include <iostream>
 
-PhysicsThread::PhysicsThread(QObject* parent)
-    : QThread(parent) {
-    start(LowPriority);
+PhysicsThread::PhysicsThread(phys::Chamber& chamber, const phys::Screen& screen, QObject* parent)
+    : QThread(parent), m_chamber(chamber), m_screen(screen) {
+    qRegisterMetaType<std::shared_ptr<const phys::Intensity>>();
 }
 
-PhysicsThread::~PhysicsThread() {}
+PhysicsThread::~PhysicsThread() {
+    {
+        QMutexLocker lock(&m_mutex);
+        m_quit = true;
+        m_cancel = true;
+        m_wake.wakeAll();
+    }
+    wait();
+}
+
+void PhysicsThread::edit(Edit change) {
+    QMutexLocker lock(&m_mutex);
+    m_edits.push_back(std::move(change));
+}
+
+void PhysicsThread::query(Query reader) {
+    QMutexLocker lock(&m_mutex);
+    m_queries.push_back(std::move(reader));
+    m_wake.wakeAll();
+}
+
+void PhysicsThread::recompute(bool preview) {
+    QMutexLocker lock(&m_mutex);
+    m_requested = true;
+    m_preview = preview;
+    m_cancel = true;
+    m_wake.wakeAll();
+}
 
 void PhysicsThread::run() {
+    phys::parallel::Cancellation cancellation(m_cancel);
+
     forever {
+        std::vector<Edit> edits;
+        std::vector<Query> queries;
+        bool preview;
         {
             QMutexLocker lock(&m_mutex);
-            if (m_stopped) {
-                m_allow_run.wait(&m_mutex);
+            while(!m_quit && (m_stopped || (!m_requested && !m_refine && m_queries.empty()))) {
+                m_wake.wait(&m_mutex);
+            }
+            if(m_quit) {
+                return;
             }
 
-            // m_chamber.step();
+            edits.swap(m_edits);
+            queries.swap(m_queries);
+            preview = m_requested && m_preview;
+            m_requested = false;
+            m_refine = false;
+            m_cancel = false;
         }
 
-        if (m_period != -1) {
-            long time = static_cast<long>(std::pow(1.2, m_period));
-            time = std::min(time, 5'000'000l);
-            if (time < 0)
-                time = 5'000'000l;
-            usleep(time);
-        } else {
+        for(Edit& change : edits) {
+            change(m_chamber);
+        }
+
+        const phys::PropagationConfig config = m_chamber.getPropagation();
+        if(preview) {
+            m_chamber.setSinCos(phys::SinCos::Table);
+        }
+        const bool done = m_chamber.update();
+        m_chamber.setPropagation(config);
+
+        if(!done) {
+            // Whatever cancelled it asked for another update.
             QMutexLocker lock(&m_mutex);
-            while(m_period.loadRelaxed() == -1) {
-                // m_chamber.step();
-            }
+            m_queries.insert(m_queries.begin(), queries.begin(), queries.end());
+            continue;
+        }
+
+        emit frameReady(m_screen.frame());
+        for(Query& reader : queries) {
+            reader(m_chamber);
+        }
+
+        if(preview) {
+            QMutexLocker lock(&m_mutex);
+            m_refine = true;
         }
     }
 }
@@ -40,11 +95,14 @@ void PhysicsThread::run() {
     return m_stopped;
 }
 
-int PhysicsThread::getPeriod() const {
-    return m_period;
-}
-
-void PhysicsThread::setPeriod(int newPeriod)
-{
-    m_period.storeRelaxed(newPeriod);
+void PhysicsThread::setStopped(bool stopped) {
+    {
+        QMutexLocker lock(&m_mutex);
+        if(m_stopped == stopped) {
+            return;
+        }
+        m_stopped = stopped;
+        m_wake.wakeAll();
+    }
+    emit toggled(!stopped);
 }
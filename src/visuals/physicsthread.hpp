@@ -1,66 +1,90 @@
 #ifndef PHYSICSTHREAD_HPP
 #define PHYSICSTHREAD_HPP
 
+#include "chamber.hpp"
+#include "screen.hpp"
 #include <QMutex>
 #include <QThread>
 #include <QWaitCondition>
-#include <QAtomicInt>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
 
+// Runs Chamber::update off the GUI thread. Once it started, the chamber and
+// its surfaces belong to this thread: the GUI changes them through edit()
+// and reads them through query(), both run here.
+//
+// Requests coalesce, latest wins: all edits queued while an update runs
+// are applied together before the next one, and an update a new request
+// makes obsolete is cancelled within a parallel::forRanges chunk.
 class PhysicsThread : public QThread {
     Q_OBJECT
 public:
-    PhysicsThread(QObject* parent = nullptr);
+    using Edit  = std::function<void(phys::Chamber&)>;
+    using Query = std::function<void(const phys::Chamber&)>;
+
+    // Every finished update posts the frame of screen through
+    // frameReady; the GUI paints it without a copy or a lock. The first
+    // update runs as soon as the thread is started, so connect to
+    // frameReady before calling start().
+    PhysicsThread(phys::Chamber& chamber, const phys::Screen& screen, QObject* parent = nullptr);
     ~PhysicsThread() override;
 
+    // Queues a change of the scene. It is applied in order with the other
+    // edits, before the next update, which it does not ask for by itself.
+    void edit(Edit change);
+
+    // Runs once an update with every edit queued before it finished.
+    void query(Query reader);
+
 public slots:
+    // Asks for an update and cancels the one in flight. A preview runs
+    // with the table sin/cos, and the exact update follows it unless
+    // another request comes in first.
+    void recompute(bool preview = false);
 
+    // Paused, requests queue up and nothing is computed.
     void stop() {
-        m_stopped = true;
-        emit toggled(false);
+        setStopped(true);
     }
 
     void cont() {
-        m_mutex.lock();
-        if (m_stopped) {
-            m_stopped = false;
-            m_allow_run.wakeAll();
-            emit toggled(true);
-        }
-        m_mutex.unlock();
+        setStopped(false);
     }
 
     void toggle() {
-        m_mutex.lock();
-        m_stopped ^= 1;
-        if (m_stopped) {
-            m_mutex.unlock();
-            emit toggled(false);
-            return;
-        }
-
-        m_allow_run.wakeAll();
-        emit toggled(true);
-        m_mutex.unlock();
+        setStopped(!getStopped());
     }
 
 public:
-    [[nodiscard]] int getPeriod() const;
     [[nodiscard]] bool getStopped();
 
 signals:
     void toggled(bool);
 
-public slots:
-    void setPeriod(int newPeriod);
+    void frameReady(std::shared_ptr<const phys::Intensity> frame);
 
 protected:
     void run() override;
 
 private:
+    phys::Chamber& m_chamber;
+    const phys::Screen& m_screen;
+
     QMutex m_mutex;
-    QWaitCondition m_allow_run;
-    QAtomicInt m_stopped = true;
-    QAtomicInt m_period = 32;
+    QWaitCondition m_wake;
+    std::vector<Edit> m_edits;
+    std::vector<Query> m_queries;
+    bool m_requested = true;
+    bool m_preview = false;
+    bool m_refine = false;
+    bool m_stopped = false;
+    bool m_quit = false;
+
+    std::atomic<bool> m_cancel = false;
+
+    void setStopped(bool stopped);
 };
 
 #endif // PHYSICSTHREAD_HPP
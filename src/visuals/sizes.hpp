@@ -1,12 +1,15 @@
 #ifndef VISUALS_SIZES_HPP
 #define VISUALS_SIZES_HPP
 
+#include "presets.hpp"
 #include "units.hpp"
+#include <cstddef>
 
-constexpr const phys::Length XBoxSize      = 1e-2_m;
-
-constexpr const phys::Length XMid          = XBoxSize / 2.__;
+constexpr const phys::Length XBoxSize      = phys::presets::BoxSize;
 
 constexpr const phys::Length ZScale        = 1e-2_m;
 
+// Points per side of the screen, whatever size its widget has.
+constexpr const size_t ScreenResolution    = 500;
+
 #endif /* VISUALS_SIZES_HPP */